@@ -0,0 +1,52 @@
+#version 430 core
+out vec4 fragColor;
+
+uniform vec2 iResolution;
+
+uniform vec2 iViewportCenter;
+uniform float iZoom;
+
+uniform float iRadius;
+uniform float iStrokeWidth;
+
+flat in vec2 center;
+flat in vec3 fillColor;
+
+// based on https://www.shadertoy.com/view/wsByzt by nickcody
+// coord      - pixel to test
+// center     - center of circle
+// radius     - radius of circle
+// strokeWidth - thickness of circle line
+// pixelWidth - blendiness
+// backgroundColor - color to draw over
+// strokeColor - circle line color
+// fillColor - circle fill color
+// All colors are premultiplied RGBA so the result can be blended over the world pass.
+vec4 circle(vec2 coord, vec2 center, float radius, float strokeWidth, float pixelWidth, vec4 backgroundColor, vec4 strokeColor, vec4 fillColor) {
+    float dist_to_center = distance(coord, center);
+    float delta = dist_to_center-radius;
+
+    float blend = smoothstep(0., pixelWidth, abs(delta) - strokeWidth);
+    
+    if (delta  < 0.) {
+    	// inside  edge
+        return mix(strokeColor, fillColor, blend);
+    } else if (delta  > 0.) {
+    	// outside edge
+        return mix(strokeColor, backgroundColor, blend);
+    } else {
+        return strokeColor;
+    }       
+}
+
+void main()
+{
+    vec2 uv = ((gl_FragCoord.xy + iViewportCenter) - iResolution.xy * 0.5) / min(iResolution.x, iResolution.y) * iZoom;
+
+    vec4 backgroundColor = vec4(0.0);
+    vec4 strokeColor = vec4(0.0, 0.0, 0.0, 1.0);
+
+    float blur = (2. * iZoom)/iResolution.y;
+
+    fragColor = circle(uv, center, iRadius, iStrokeWidth, blur, backgroundColor, strokeColor, vec4(fillColor, 1.0));
+}
@@ -0,0 +1,42 @@
+#version 430 core
+layout (location = 0) in vec2 corner;   // corner of the unit quad in [-1,1]
+
+uniform vec2 iResolution;
+
+uniform vec2 iViewportCenter;
+uniform float iZoom;
+
+uniform float iRadius;
+uniform float iStrokeWidth;
+
+struct Agent
+{
+    vec2 position;
+    float heading;
+    uint color;             // RGBA8, see render::packColor()
+};
+
+// tightly packed, runtime-sized population (16 bytes per agent)
+layout (std430, binding = 0) readonly buffer Population
+{
+    Agent agents[];
+};
+
+flat out vec2 center;
+flat out vec3 fillColor;
+
+void main()
+{
+    Agent agent = agents[gl_InstanceID];
+
+    center = agent.position;
+    fillColor = unpackUnorm4x8(agent.color).rgb;
+
+    // the quad must cover the circle including its stroke and antialiasing falloff
+    float blur = (2. * iZoom)/iResolution.y;
+    vec2 uv = center + corner * (iRadius + iStrokeWidth + blur);
+
+    // inverse of the pixel-to-world mapping in agent.frag/world.frag
+    vec2 fragCoord = uv / iZoom * min(iResolution.x, iResolution.y) + iResolution.xy * 0.5 - iViewportCenter;
+    gl_Position = vec4(fragCoord / iResolution.xy * 2.0 - 1.0, 0.0, 1.0);
+}
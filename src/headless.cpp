@@ -0,0 +1,7 @@
+#include "sim/headless.h"
+
+// Entry point of the window-less build for compute servers; links only the simulation core.
+int main(int argc, char *argv[])
+{
+    return sim::runHeadless(argc, argv);
+}
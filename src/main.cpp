@@ -1,6 +1,7 @@
 #include <string>
 #include <iostream>
 #include <filesystem>
+#include <algorithm>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -11,6 +12,12 @@
 
 #include "util/util.h"
 #include "util/shader.h"
+#include "util/program.h"
+#include "util/reloader.h"
+#include "render/population.h"
+#include "sim/headless.h"
+#include "sim/simthread.h"
+#include "sim/targetfield.h"
 
 const std::string programName = "AI-Agent Simulation";
 const float frameCounterInterval_s = 1.0;
@@ -27,26 +34,62 @@ int frameCounter = 0;
 int iFrame = 0;
 
 glm::vec2 viewportCenter = {0,0};
-float viewportZoom = 1.0;
+float viewportZoom = -15.0; // shows the whole default world
 
 std::filesystem::path currentPath = ".";
 std::filesystem::path basePath = ".";
 
-std::string fontName = "JetBrainsMono-ExtraLight.ttf";
-std::string vertexShaderFileName = "/home/henry/dev/ai-agent/assets/shader/world.vert";
-std::string fragmentShaderFileName = "/home/henry/dev/ai-agent/assets/shader/world.frag";
+std::filesystem::path assetPath = "assets";
+
+// relative to assetPath, see findAssetPath()
+std::string fontName = "fonts/JetBrainsMono/JetBrainsMono-ExtraLight.ttf";
+std::string vertexShaderFileName = "shader/world.vert";
+std::string fragmentShaderFileName = "shader/world.frag";
+std::string agentVertexShaderFileName = "shader/agent.vert";
+std::string agentFragmentShaderFileName = "shader/agent.frag";
 
 GLFWwindow *glfWindow = nullptr;
 GLFWmonitor *monitor = nullptr;
 const GLFWvidmode *mode = nullptr;
 
-GLuint shaderProgram, VBO, VAO, texture, population;
+GLuint VBO, VAO, texture;
+GLuint agentVBO, agentVAO;
+shader::Program worldProgram, agentProgram;
+shader::ProgramReloader shaderReloader;
+
+// uniform and block names are hashed at compile time, see shader::Name
+namespace uniforms
+{
+    constexpr shader::Name iFrame("iFrame"), iTime("iTime"), iResolution("iResolution"), iViewportCenter("iViewportCenter"),
+        iZoom("iZoom"), iWorldSize("iWorldSize"), iRadius("iRadius"), iStrokeWidth("iStrokeWidth");
+    constexpr shader::Name Population("Population");
+}
+
+render::PopulationBuffer population;
+GLuint populationBindingIndex = 0; // introspected from the `Population` block in agent.vert
+
+const float agentStrokeWidth = 0.0001f;
+
+sim::Config simConfig;
+sim::SimulationThread simThread(simConfig);
+
+// the world shader draws the baked target field instead of the checkerboard
+const bool showTargetField = true;
+sim::TargetField targetField;
+
+// simulation speed, see sim::FixedTimestep::setSpeed()
+const double speedOptions[] = {1.0, 2.0, 5.0, 10.0, 100.0, 1000.0, 0.0};
+const char *speedNames[] = {"1x", "2x", "5x", "10x", "100x", "1000x", "max"};
+int speedOption = 0;
+uint64_t prevStepCount = 0;
+float stepsPerSecond = 0.0f;
+
+// the two newest snapshots; the renderer interpolates from the previous to the current one
+sim::Snapshot previousSnapshot, currentSnapshot;
 float pixels[] = {
     0.9f, 0.9f, 0.9f,   1.0f, 1.0f, 1.0f,
     1.0f, 1.0f, 1.0f,   0.9f, 0.9f, 0.9f};
 
-float populationData[256 * 4];
-
 static void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
@@ -67,6 +110,9 @@ static void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 
 void teardown()
 {
+    simThread.stop();
+    shaderReloader.stop();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -74,7 +120,11 @@ void teardown()
     // optional: de-allocate all resources once they've outlived their purpose
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
-    glDeleteProgram(shaderProgram);
+    worldProgram.destroy();
+    glDeleteVertexArrays(1, &agentVAO);
+    glDeleteBuffers(1, &agentVBO);
+    population.destroy();
+    agentProgram.destroy();
 
     if (glfWindow)
     {
@@ -165,16 +215,19 @@ bool initializeGLAD()
     std::cout << "[INFO] OpenGL Version: " << GLVersion.major << "." << GLVersion.minor << std::endl;
     std::cout << "[INFO] Shader Language Version: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
 
-    // Check GL_MAX_UNIFORM_BLOCK_SIZE to make sure we can allocate enough UBO memory
-    int32_t maxUniformBlockSize;
-    glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &maxUniformBlockSize);
-    std::cout << "[INFO] GL_MAX_UNIFORM_BLOCK_SIZE: " << maxUniformBlockSize << std::endl;
-    if(maxUniformBlockSize < 65536) 
+    // the population is stored in a shader storage buffer which requires OpenGL 4.3
+    if (!GLAD_GL_VERSION_4_3)
     {
-        std::cerr << "[ERROR] GL_MAX_UNIFORM_BLOCK_SIZE must be >=65536" << std::endl;
+        std::cerr << "[ERROR] OpenGL 4.3 is required for shader storage buffers" << std::endl;
         return false;
     }
 
+    // GL_MAX_SHADER_STORAGE_BLOCK_SIZE limits the number of agents that can be drawn at once
+    int64_t maxStorageBlockSize;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxStorageBlockSize);
+    std::cout << "[INFO] GL_MAX_SHADER_STORAGE_BLOCK_SIZE: " << maxStorageBlockSize
+              << " (" << maxStorageBlockSize / int64_t(sizeof(render::AgentInstance)) << " agents)" << std::endl;
+
     return true;
 }
 
@@ -206,10 +259,22 @@ bool initializeDearImGui()
     return true;
 }
 
+// the agents are read from the Population block, which must hold render::AgentInstance
+bool checkAgentProgram(const shader::Program &program)
+{
+    if (!program.blockMatches<render::AgentInstance>(GL_SHADER_STORAGE_BLOCK, uniforms::Population) ||
+        program.storageBlockBinding(uniforms::Population) < 0)
+    {
+        std::cerr << "[ERROR] The Population block in " << agentVertexShaderFileName << " does not match render::AgentInstance" << std::endl;
+        return false;
+    }
+    return true;
+}
+
 // build and compile our shader program
 bool buildShaderProgram()
 {
-    if (!shader::loadShader(vertexShaderFileName.c_str(), fragmentShaderFileName.c_str(), nullptr /*geometryShader*/, &shaderProgram))
+    if (!worldProgram.load(vertexShaderFileName, fragmentShaderFileName))
     {
         return false;
     }
@@ -262,27 +327,103 @@ bool buildShaderProgram()
     // add texture
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 2, 2, 0, GL_RGB, GL_FLOAT, pixels);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    if (showTargetField)
+    {
+        // density and gradient per node, the same values the agents sense
+        targetField.bake(simConfig);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, targetField.resolution(), targetField.resolution(), 0, GL_RGB, GL_FLOAT, targetField.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 2, 2, 0, GL_RGB, GL_FLOAT, pixels);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
     // unbind for now
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    // add uniform buffer object for population
-    unsigned int uniformBlockIndex = glGetUniformBlockIndex(shaderProgram, "Population");
-    glUniformBlockBinding(shaderProgram, uniformBlockIndex, 0);
+    // agents are drawn as one instanced quad each, so only the covered fragments are shaded
+    if (!agentProgram.load(agentVertexShaderFileName, agentFragmentShaderFileName))
+    {
+        return false;
+    }
+    if (!checkAgentProgram(agentProgram))
+    {
+        return false;
+    }
+    populationBindingIndex = GLuint(agentProgram.storageBlockBinding(uniforms::Population));
 
-    glGenBuffers(1, &population);
-    glBindBuffer(GL_UNIFORM_BUFFER, population);
-    glBufferData(GL_UNIFORM_BUFFER, 32772, nullptr, GL_STATIC_DRAW); // allocate 12 KiB of memory
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);    
-    glBindBufferRange(GL_UNIFORM_BUFFER, 0, population, 0, 32772);
+    // unit quad as triangle strip; scaled and positioned per instance in agent.vert
+    float agentCorners[] =
+        {
+            -1.0f, -1.0f,
+            1.0f, -1.0f,
+            -1.0f, 1.0f,
+            1.0f, 1.0f,
+        };
+
+    glGenVertexArrays(1, &agentVAO);
+    glGenBuffers(1, &agentVBO);
+    glBindVertexArray(agentVAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, agentVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(agentCorners), agentCorners, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    // add shader storage buffer for population; grows with the number of agents
+    if (!population.create(simConfig.population))
+    {
+        return false;
+    }
 
     // uncomment this call to draw in wireframe polygons
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     return true;
 }
 
+// write the (interpolated) agent state into the population buffer
+void uploadPopulation()
+{
+    // snapshots arrive one interval apart, so lagging one interval behind gives smooth motion
+    if (simThread.fetch())
+    {
+        std::swap(previousSnapshot, currentSnapshot);
+        currentSnapshot = simThread.latest();
+    }
+
+    const std::vector<sim::AgentState> &agents = currentSnapshot.agents;
+    const std::vector<sim::AgentState> &previous = previousSnapshot.agents;
+    render::AgentInstance *instances = population.write(agents.size());
+    if (!instances)
+    {
+        return;
+    }
+
+    // agents are placed anew at the start of a cycle, don't interpolate across cycles
+    bool blend = previousSnapshot.cycle == currentSnapshot.cycle && previous.size() == agents.size();
+    double interval = currentSnapshot.time - previousSnapshot.time;
+    float alpha = interval > 0.0 ? std::min(float((sim::SimulationThread::now() - currentSnapshot.time) / interval), 1.0f) : 1.0f;
+    for (size_t i = 0; i < agents.size(); i++)
+    {
+        const sim::AgentState &agent = agents[i];
+        render::AgentInstance &instance = instances[i];
+        instance.x = blend ? previous[i].x + (agent.x - previous[i].x) * alpha : agent.x;
+        instance.y = blend ? previous[i].y + (agent.y - previous[i].y) * alpha : agent.y;
+        instance.heading = agent.heading;
+        instance.color = agent.color;
+    }
+    population.commit(agents.size());
+}
+
 void composeDearImGuiFrame()
 {
     ImGui_ImplOpenGL3_NewFrame();
@@ -308,6 +449,22 @@ void composeDearImGuiFrame()
     {
         ImGui::Text("Framerate: %.0fHz (%.2fms)", 1 / frameTime, frameTime * 1000.);
         ImGui::Text("Frame: %i", iFrame);
+        ImGui::Text("Agents: %zu (stalls: %zu)", population.count(), population.stallCount());
+        ImGui::Separator();
+        ImGui::Text("Cycle: %llu Step: %i", (unsigned long long)currentSnapshot.cycle, currentSnapshot.stepInCycle);
+        ImGui::Text("Steps/s: %.0f", stepsPerSecond);
+        if (ImGui::Combo("Speed", &speedOption, speedNames, IM_ARRAYSIZE(speedNames)))
+        {
+            simThread.setSpeed(speedOptions[speedOption]);
+        }
+        if (simThread.isReplaying())
+        {
+            int frame = int(simThread.replayPosition());
+            if (ImGui::SliderInt("Replay", &frame, 0, int(simThread.replay().frameCount()) - 1))
+            {
+                simThread.seek(uint64_t(frame));
+            }
+        }
         ImGui::Separator();
         if (ImGui::IsMousePosValid())
             ImGui::Text("Mouse: (%.0f,%.0f)", io.MousePos.x, io.MousePos.y);
@@ -322,6 +479,10 @@ void composeDearImGuiFrame()
 void processUserInteraction()
 {
     ImGuiIO &io = ImGui::GetIO();
+    if (io.WantCaptureMouse)
+    {
+        return;
+    }
     ImVec2 dragdelta = ImGui::GetMouseDragDelta(ImGuiMouseButton_Left);
     if(ImGui::IsMouseDragging(ImGuiMouseButton_Left))
     {
@@ -332,6 +493,12 @@ void processUserInteraction()
 
 int main(int argc, char *argv[])
 {
+    // simulation without window, see sim::printUsage() for options
+    if (sim::isHeadless(argc, argv))
+    {
+        return sim::runHeadless(argc, argv);
+    }
+
     std::cout << std::endl
               << "[INFO] Start " << util::currentTime(std::chrono::system_clock::now()) << std::endl;
 
@@ -346,10 +513,47 @@ int main(int argc, char *argv[])
     std::cout << "[DEBUG] Executable name/path: " << argv[0] << " "
               << "parent path: " << basePath << std::endl;
 
-    fontName = "/home/henry/dev/ai-agent/assets/fonts/JetBrainsMono/JetBrainsMono-ExtraLight.ttf"; //(basePath / "assets/fonts/JetBrainsMono" / fontName).string();
+    // assets are looked up next to the executable, then in the source tree of a build directory
+    for (const std::filesystem::path &candidate : {basePath / "assets", basePath / ".." / "assets", currentPath / "assets"})
+    {
+        if (std::filesystem::is_directory(candidate))
+        {
+            assetPath = candidate.lexically_normal();
+            break;
+        }
+    }
+    std::cout << "[DEBUG] Asset path: " << assetPath << std::endl;
+    for (std::string *fileName : {&fontName, &vertexShaderFileName, &fragmentShaderFileName, &agentVertexShaderFileName, &agentFragmentShaderFileName})
+    {
+        *fileName = (assetPath / *fileName).string();
+    }
 
     std::cout << "[DEBUG] Font filename: " << fontName << std::endl;
 
+    // viewer options: play a trajectory recording instead of simulating, or record the simulation
+    std::string replayFileName, recordFileName;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (std::string(argv[i]) == "--replay")
+            replayFileName = argv[++i];
+        else if (std::string(argv[i]) == "--record")
+            recordFileName = argv[++i];
+    }
+
+    // the replay defines the world that is drawn
+    if (!replayFileName.empty())
+    {
+        if (!simThread.startReplay(replayFileName))
+        {
+            return EXIT_FAILURE;
+        }
+        const sim::TrajectoryReader &replay = simThread.replay();
+        simConfig.population = replay.agents();
+        simConfig.worldSize = replay.worldSize();
+        simConfig.agentRadius = replay.agentRadius();
+        simConfig.targets = replay.targets();
+    }
+
     if (!initializeGLFW())
     {
         std::cerr << "[ERROR] GLFW initialization failed" << std::endl;
@@ -368,12 +572,39 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
+    // linked shader programs are cached next to the executable, see shader::setBinaryCacheDirectory()
+    shader::setBinaryCacheDirectory((basePath / "shadercache").string());
+
     // build and compile our shader program
+    auto shaderStart = std::chrono::steady_clock::now();
     if (!buildShaderProgram())
     {
         std::cerr << "[ERROR] Shader initialization failed" << std::endl;
         return EXIT_FAILURE;
     }
+    std::cout << "[INFO] Shader initialization took "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count() << "ms" << std::endl;
+
+    // edited shaders are rebuilt in the background and swapped in at the start of a frame
+    shaderReloader.watch(worldProgram, vertexShaderFileName, fragmentShaderFileName);
+    shaderReloader.watch(agentProgram, agentVertexShaderFileName, agentFragmentShaderFileName, checkAgentProgram);
+    if (!shaderReloader.start(glfWindow))
+    {
+        std::cout << "[INFO] Shader hot reload is not available" << std::endl;
+    }
+
+    if (!simThread.isReplaying())
+    {
+        if (!recordFileName.empty() && !simThread.record(recordFileName))
+        {
+            return EXIT_FAILURE;
+        }
+        if (!simThread.start())
+        {
+            std::cerr << "[ERROR] Simulation initialization failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
     // rendering loop
     while (!glfwWindowShouldClose(glfWindow))
@@ -386,37 +617,62 @@ int main(int argc, char *argv[])
         if ((currTimestamp - prevTimestamp) > frameCounterInterval_s)
         {
             frameTime = (currTimestamp - prevTimestamp) / float(frameCounter);
+            stepsPerSecond = (currentSnapshot.steps - prevStepCount) / (currTimestamp - prevTimestamp);
+            prevStepCount = currentSnapshot.steps;
             prevTimestamp = currTimestamp;
             frameCounter = 0;
         }
 
+        // rebuilt programs start with an empty uniform cache, so all values are uploaded again
+        if (shaderReloader.apply() > 0)
+        {
+            populationBindingIndex = GLuint(agentProgram.storageBlockBinding(uniforms::Population));
+        }
+
         // the frame starts with a clean scene
         glClearColor(backgroundR, backgroundG, backgroundB, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
         // draw our triangle
-        glUseProgram(shaderProgram);
+        worldProgram.use();
 
-        shader::setFloat(shaderProgram, "iFrame", iFrame);
-        shader::setFloat(shaderProgram, "iTime", currTimestamp);
-        shader::setVec2(shaderProgram, "iResolution", glm::vec2(windowWidth, windowHeight));
-        shader::setVec2(shaderProgram, "iViewportCenter", viewportCenter);
-        shader::setFloat(shaderProgram, "iZoom", exp(-viewportZoom/10.));
+        worldProgram.set(uniforms::iFrame, iFrame);
+        worldProgram.set(uniforms::iTime, currTimestamp);
+        worldProgram.set(uniforms::iResolution, glm::vec2(windowWidth, windowHeight));
+        worldProgram.set(uniforms::iViewportCenter, viewportCenter);
+        worldProgram.set(uniforms::iZoom, float(exp(-viewportZoom/10.)));
+        worldProgram.set(uniforms::iWorldSize, showTargetField ? simConfig.worldSize : 0.0f);
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texture);
 
-        glBindBuffer(GL_UNIFORM_BUFFER, population);
-        int popCount = (iFrame) % 1000;
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, 4, &popCount); 
-        // glBindBuffer(GL_UNIFORM_BUFFER, 0);        
-
         // seeing as we only have a single VAO there's no need to bind it every time,
         // but we'll do so to keep things a bit more organized
         glBindVertexArray(VAO);
         glDrawArrays(GL_TRIANGLES, 0, 2 * 3);
         // glBindVertexArray(0); // no need to unbind it every time
 
+        // agents are written straight into GPU-visible memory
+        uploadPopulation();
+        population.bind(populationBindingIndex);
+
+        // draw all agents with one instanced call; agent.frag outputs premultiplied alpha
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+        agentProgram.use();
+
+        agentProgram.set(uniforms::iResolution, glm::vec2(windowWidth, windowHeight));
+        agentProgram.set(uniforms::iViewportCenter, viewportCenter);
+        agentProgram.set(uniforms::iZoom, float(exp(-viewportZoom/10.)));
+        agentProgram.set(uniforms::iRadius, simConfig.agentRadius);
+        agentProgram.set(uniforms::iStrokeWidth, agentStrokeWidth);
+
+        glBindVertexArray(agentVAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(population.count()));
+
+        glDisable(GL_BLEND);
+
         // Dear ImGui frame
         composeDearImGuiFrame();
 
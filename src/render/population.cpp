@@ -0,0 +1,185 @@
+#include "population.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace render
+{
+    uint32_t packColor(float r, float g, float b, float a)
+    {
+        // same convention as GLSL packUnorm4x8(): first component in the lowest byte
+        auto unorm8 = [](float v) -> uint32_t
+        { return static_cast<uint32_t>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f); };
+        return unorm8(r) | (unorm8(g) << 8) | (unorm8(b) << 16) | (unorm8(a) << 24);
+    }
+
+    bool PopulationBuffer::create(size_t initialCapacity)
+    {
+        persistent = GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+        std::cout << "[INFO] Population buffer upload path: "
+                  << (persistent ? "persistent mapped ring buffer" : "glBufferSubData") << std::endl;
+
+        return allocate(std::max<size_t>(initialCapacity, 1));
+    }
+
+    void PopulationBuffer::destroy()
+    {
+        release();
+        agentCount = 0;
+        agentCapacity = 0;
+    }
+
+    void PopulationBuffer::release()
+    {
+        for (int i = 0; i < regionCount; i++)
+        {
+            waitForRegion(i);
+        }
+        if (mapped)
+        {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+            glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            mapped = nullptr;
+        }
+        if (buffer)
+        {
+            glDeleteBuffers(1, &buffer);
+            buffer = 0;
+        }
+        committedRegion = -1;
+    }
+
+    bool PopulationBuffer::allocate(size_t requiredCapacity)
+    {
+        size_t newCapacity = std::max<size_t>(agentCapacity, 1);
+        while (newCapacity < requiredCapacity)
+        {
+            newCapacity *= 2;
+        }
+
+        // the old storage is gone, so a failure below leaves no capacity at all
+        release();
+        agentCapacity = 0;
+
+        glGenBuffers(1, &buffer);
+        if (!buffer)
+        {
+            std::cerr << "[ERROR] Could not create population buffer" << std::endl;
+            return false;
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+
+        if (persistent)
+        {
+            // every region must start at a valid offset for glBindBufferRange()
+            GLint offsetAlignment = 1;
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+            size_t alignment = std::max<size_t>(offsetAlignment, sizeof(AgentInstance)) / sizeof(AgentInstance);
+            regionStride = (newCapacity + alignment - 1) / alignment * alignment;
+
+            GLsizeiptr size = regionCount * regionStride * sizeof(AgentInstance);
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_SHADER_STORAGE_BUFFER, size, nullptr, flags);
+            mapped = static_cast<AgentInstance *>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size, flags));
+            if (!mapped)
+            {
+                std::cerr << "[ERROR] Could not map population buffer (" << size << " Bytes)" << std::endl;
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+                return false;
+            }
+        }
+        else
+        {
+            regionStride = newCapacity;
+            glBufferData(GL_SHADER_STORAGE_BUFFER, newCapacity * sizeof(AgentInstance), nullptr, GL_STREAM_DRAW);
+            staging.resize(newCapacity);
+        }
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        agentCapacity = newCapacity;
+
+        std::cout << "[INFO] Population buffer capacity: " << agentCapacity << " agents ("
+                  << agentCapacity * sizeof(AgentInstance) << " Bytes"
+                  << (persistent ? " per region)" : ")") << std::endl;
+        return true;
+    }
+
+    void PopulationBuffer::waitForRegion(int region)
+    {
+        if (!fences[region])
+        {
+            return;
+        }
+
+        // poll first so only real waits are counted, then flush and block until the GPU is done
+        GLenum result = glClientWaitSync(fences[region], 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            stalls++;
+            do
+            {
+                result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            } while (result == GL_TIMEOUT_EXPIRED);
+        }
+        if (result == GL_WAIT_FAILED)
+        {
+            std::cerr << "[ERROR] Waiting for population buffer region " << region << " failed" << std::endl;
+        }
+
+        glDeleteSync(fences[region]);
+        fences[region] = 0;
+    }
+
+    AgentInstance *PopulationBuffer::write(size_t count)
+    {
+        if (!persistent)
+        {
+            if (count > agentCapacity && !allocate(count))
+            {
+                return nullptr;
+            }
+            return staging.data();
+        }
+
+        // all draw calls reading the committed region have been issued by now
+        if (committedRegion >= 0 && !fences[committedRegion])
+        {
+            fences[committedRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        if (count > agentCapacity && !allocate(count))
+        {
+            return nullptr;
+        }
+
+        writeRegion = (committedRegion + 1) % regionCount;
+        waitForRegion(writeRegion);
+        return mapped + writeRegion * regionStride;
+    }
+
+    void PopulationBuffer::commit(size_t count)
+    {
+        agentCount = std::min(count, agentCapacity);
+        committedRegion = writeRegion;
+
+        if (!persistent)
+        {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, agentCount * sizeof(AgentInstance), staging.data());
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+    }
+
+    void PopulationBuffer::bind(GLuint bindingIndex) const
+    {
+        if (committedRegion < 0)
+        {
+            return;
+        }
+        // zero-sized ranges are invalid, so always bind at least one record
+        GLintptr offset = committedRegion * regionStride * sizeof(AgentInstance);
+        GLsizeiptr size = std::max<size_t>(agentCount, 1) * sizeof(AgentInstance);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, bindingIndex, buffer, offset, size);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+namespace render
+{
+    // Per-agent record as laid out in the std430 `Population` storage block (see agent.vert).
+    // 16 bytes, no padding; the color is packed RGBA8 and unpacked with unpackUnorm4x8() on the GPU.
+    struct AgentInstance
+    {
+        float x, y;
+        float heading;
+        uint32_t color;
+    };
+    static_assert(sizeof(AgentInstance) == 16, "AgentInstance must match the std430 layout in agent.vert");
+
+    uint32_t packColor(float r, float g, float b, float a = 1.0f);
+
+    // Streaming shader storage buffer holding the population that is drawn by the instanced agent pass.
+    //
+    // The buffer is split into three regions that are persistently and coherently mapped
+    // (glBufferStorage, GL 4.4 or ARB_buffer_storage). Each frame write() hands out the next region,
+    // commit() publishes it and bind() attaches it to the storage block. A fence is placed behind the
+    // draw calls of a region, so the CPU only waits if it gets three frames ahead of the GPU.
+    // Without buffer storage support the records are staged in system memory and uploaded with
+    // glBufferSubData() on commit().
+    class PopulationBuffer
+    {
+    public:
+        static const int regionCount = 3;
+
+        bool create(size_t initialCapacity);
+        void destroy();
+
+        // Returns storage for `count` agents; the pointer is valid until the next call to write().
+        AgentInstance *write(size_t count);
+        // Publishes the first `count` agents of the last write() for drawing.
+        void commit(size_t count);
+        // Binds the committed agents to the given storage block binding.
+        void bind(GLuint bindingIndex) const;
+
+        size_t count() const { return agentCount; }
+        size_t capacity() const { return agentCapacity; }
+        bool isPersistent() const { return persistent; }
+        // number of times write() had to wait for the GPU to release a region
+        size_t stallCount() const { return stalls; }
+
+    private:
+        bool allocate(size_t requiredCapacity);
+        void release();
+        void waitForRegion(int region);
+
+        GLuint buffer = 0;
+        bool persistent = false;
+        AgentInstance *mapped = nullptr;
+        GLsync fences[regionCount] = {};
+        size_t regionStride = 0; // in agents, respects GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+
+        int writeRegion = 0;
+        int committedRegion = -1;
+
+        std::vector<AgentInstance> staging;
+
+        size_t agentCount = 0;
+        size_t agentCapacity = 0;
+        size_t stalls = 0;
+    };
+}
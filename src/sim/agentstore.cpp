@@ -0,0 +1,98 @@
+#include "agentstore.h"
+
+#include <algorithm>
+
+namespace sim
+{
+    void AgentStore::reset(int genomeSize, int hiddenSize)
+    {
+        genomeLength = genomeSize;
+        hiddenCount = hiddenSize;
+        clear();
+    }
+
+    void AgentStore::clear()
+    {
+        x.clear();
+        y.clear();
+        velocity.clear();
+        heading.clear();
+        energy.clear();
+        hidden.clear();
+        genes.clear();
+        color.clear();
+        lineage.clear();
+        birthCycle.clear();
+    }
+
+    void AgentStore::reserve(size_t capacity)
+    {
+        x.reserve(capacity);
+        y.reserve(capacity);
+        velocity.reserve(capacity);
+        heading.reserve(capacity);
+        energy.reserve(capacity);
+        hidden.reserve(capacity * hiddenCount);
+        genes.reserve(capacity * genomeLength);
+        color.reserve(capacity);
+        lineage.reserve(capacity);
+        birthCycle.reserve(capacity);
+    }
+
+    void AgentStore::bindGenomes(Arena *arena)
+    {
+        rebind(genes, arena);
+    }
+
+    size_t AgentStore::add()
+    {
+        return add(1);
+    }
+
+    size_t AgentStore::add(size_t count)
+    {
+        size_t first = size();
+        size_t total = first + count;
+        x.resize(total, 0.0f);
+        y.resize(total, 0.0f);
+        velocity.resize(total, 0.0f);
+        heading.resize(total, 0.0f);
+        energy.resize(total, 0.0f);
+        hidden.resize(total * hiddenCount, 0.0f);
+        genes.resize(total * genomeLength, 0);
+        color.resize(total, 0);
+        lineage.resize(total, 0);
+        birthCycle.resize(total, 0);
+        return first;
+    }
+
+    // gathers `width` values per agent in the new order through `scratch`, then copies them back
+    template <typename Column>
+    static void gather(Column &column, const uint32_t *order, size_t count, size_t width, std::vector<uint64_t> &scratch)
+    {
+        typedef typename Column::value_type T;
+        static_assert(alignof(T) <= alignof(uint64_t), "scratch alignment");
+        scratch.resize((column.size() * sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        T *reordered = reinterpret_cast<T *>(scratch.data());
+        for (size_t i = 0; i < count; i++)
+        {
+            std::copy_n(column.begin() + size_t(order[i]) * width, width, reordered + i * width);
+        }
+        std::copy_n(reordered, count * width, column.begin());
+    }
+
+    void AgentStore::reorder(const uint32_t *order)
+    {
+        size_t count = size();
+        gather(x, order, count, 1, reorderScratch);
+        gather(y, order, count, 1, reorderScratch);
+        gather(velocity, order, count, 1, reorderScratch);
+        gather(heading, order, count, 1, reorderScratch);
+        gather(energy, order, count, 1, reorderScratch);
+        gather(hidden, order, count, hiddenCount, reorderScratch);
+        gather(genes, order, count, genomeLength, reorderScratch);
+        gather(color, order, count, 1, reorderScratch);
+        gather(lineage, order, count, 1, reorderScratch);
+        gather(birthCycle, order, count, 1, reorderScratch);
+    }
+}
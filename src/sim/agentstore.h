@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "aligned.h"
+#include "arena.h"
+#include "genome.h"
+
+namespace sim
+{
+    // Structure of arrays container for all agents of a world.
+    //
+    // Hot fields that are read or written every step live in separate cache line aligned arrays,
+    // so the sensor and movement loops stream through memory linearly and can be vectorized.
+    // Cold fields that are only touched once per cycle (genome, lineage, ...) are kept apart.
+    // Agents are stored densely at indices 0..size()-1. A generation is never thinned out in place:
+    // reproduction builds the next generation in a second store and swaps it in.
+    class AgentStore
+    {
+    public:
+        void reset(int genomeLength, int hiddenCount);
+        void clear();
+        void reserve(size_t capacity);
+        // genomes are allocated from `arena` from now on (nullptr: heap); drops the current genomes,
+        // so the store should be empty
+        void bindGenomes(Arena *arena);
+
+        size_t size() const { return x.size(); }
+        bool empty() const { return x.empty(); }
+
+        // appends an agent with zeroed fields and returns its index
+        size_t add();
+        // appends `count` agents with zeroed fields and returns the index of the first
+        size_t add(size_t count);
+        // agent i becomes the former agent order[i]; `order` is a permutation of 0..size()-1
+        void reorder(const uint32_t *order);
+        Gene *genome(size_t index) { return &genes[index * genomeLength]; }
+        const Gene *genome(size_t index) const { return &genes[index * genomeLength]; }
+        float *hiddenState(size_t index) { return &hidden[index * hiddenCount]; }
+
+        int genomeSize() const { return genomeLength; }
+        int hiddenSize() const { return hiddenCount; }
+
+        // hot fields
+        AlignedVector<float> x, y;
+        AlignedVector<float> velocity; // along the heading, 0..maxSpeed
+        AlignedVector<float> heading;  // radians, -pi..pi
+        AlignedVector<float> energy;   // 0..1
+        AlignedVector<float> hidden;   // hidden neuron values of the last step, hiddenCount per agent
+
+        // cold fields
+        ArenaVector<Gene> genes;          // genomeLength per agent, back to back
+        std::vector<uint32_t> color;      // RGBA8, derived from the genome
+        std::vector<uint32_t> lineage;    // index of the first ancestor in the initial population
+        std::vector<uint64_t> birthCycle;
+
+    private:
+        int genomeLength = 0;
+        int hiddenCount = 0;
+        std::vector<uint64_t> reorderScratch; // one column, reused so reorder() does not allocate
+    };
+}
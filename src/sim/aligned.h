@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace sim
+{
+    // size of a cache line, hot per-agent arrays start on their own line
+    const size_t cacheLineSize = 64;
+
+    template <typename T, size_t Alignment = cacheLineSize>
+    struct AlignedAllocator
+    {
+        typedef T value_type;
+
+        template <typename U>
+        struct rebind
+        {
+            typedef AlignedAllocator<U, Alignment> other;
+        };
+
+        AlignedAllocator() = default;
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+        T *allocate(size_t count)
+        {
+            return static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+        }
+
+        void deallocate(T *pointer, size_t)
+        {
+            ::operator delete(pointer, std::align_val_t(Alignment));
+        }
+
+        template <typename U>
+        bool operator==(const AlignedAllocator<U, Alignment> &) const { return true; }
+        template <typename U>
+        bool operator!=(const AlignedAllocator<U, Alignment> &) const { return false; }
+    };
+
+    template <typename T>
+    using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+}
@@ -0,0 +1,84 @@
+#include "arena.h"
+
+#include <new>
+
+namespace sim
+{
+    Arena::Arena(size_t blockSize) : blockSize(blockSize)
+    {
+    }
+
+    Arena::~Arena()
+    {
+        release();
+    }
+
+    void *Arena::allocate(size_t bytes, size_t alignment)
+    {
+        size_t start = blocks.empty() ? 0 : (offset + alignment - 1) / alignment * alignment;
+        if (blocks.empty() || start + bytes > blocks.back().size)
+        {
+            // blocks are cache line aligned, larger alignments need room to move the start
+            addBlock(bytes + (alignment > cacheLineSize ? alignment : 0));
+            start = (reinterpret_cast<size_t>(blocks.back().data) + alignment - 1) / alignment * alignment -
+                    reinterpret_cast<size_t>(blocks.back().data);
+        }
+        usedBytes += start + bytes - offset;
+        offset = start + bytes;
+        return blocks.back().data + start;
+    }
+
+    void Arena::addBlock(size_t minimumSize)
+    {
+        size_t size = minimumSize > blockSize ? minimumSize : blockSize;
+        blocks.push_back({static_cast<char *>(::operator new(size, std::align_val_t(cacheLineSize))), size});
+        blockAllocations++;
+        offset = 0;
+    }
+
+    void Arena::reset()
+    {
+        if (blocks.size() > 1)
+        {
+            size_t total = capacity();
+            release();
+            addBlock(total);
+        }
+        offset = 0;
+        usedBytes = 0;
+    }
+
+    void Arena::release()
+    {
+        for (const Block &block : blocks)
+        {
+            ::operator delete(block.data, std::align_val_t(cacheLineSize));
+        }
+        blocks.clear();
+        offset = 0;
+        usedBytes = 0;
+    }
+
+    size_t Arena::capacity() const
+    {
+        size_t total = 0;
+        for (const Block &block : blocks)
+        {
+            total += block.size;
+        }
+        return total;
+    }
+
+    Arena &GenerationArena::beginNext()
+    {
+        next().reset();
+        return next();
+    }
+
+    void GenerationArena::reset()
+    {
+        arenas[0].reset();
+        arenas[1].reset();
+        currentIndex = 0;
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "aligned.h"
+
+namespace sim
+{
+    // Bump allocator for data that lives exactly as long as one generation of agents.
+    //
+    // allocate() hands out consecutive pieces of large blocks, deallocation is a no-op and reset()
+    // releases everything at once. The blocks are kept across reset(); if a generation needed
+    // more than one block they are merged into a single block of the combined size, so once the
+    // population has reached its size an arena no longer touches the heap.
+    // An arena is not thread-safe, it is filled by the sequential parts of the simulation.
+    class Arena
+    {
+    public:
+        explicit Arena(size_t blockSize = size_t(1) << 20);
+        ~Arena();
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        void *allocate(size_t bytes, size_t alignment = cacheLineSize);
+        void reset();
+        // returns all blocks to the heap
+        void release();
+
+        size_t used() const { return usedBytes; }
+        size_t capacity() const;
+        // blocks requested from the heap since construction
+        size_t heapAllocations() const { return blockAllocations; }
+
+    private:
+        struct Block
+        {
+            char *data;
+            size_t size;
+        };
+
+        void addBlock(size_t minimumSize);
+
+        size_t blockSize;
+        std::vector<Block> blocks;
+        size_t offset = 0; // into blocks.back()
+        size_t usedBytes = 0;
+        size_t blockAllocations = 0;
+    };
+
+    // Standard allocator on top of an arena; without an arena it falls back to the heap, so
+    // containers work the same before they are bound to a generation.
+    template <typename T>
+    struct ArenaAllocator
+    {
+        typedef T value_type;
+        // containers take their arena along, see rebind()
+        typedef std::true_type propagate_on_container_copy_assignment;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        ArenaAllocator() = default;
+        explicit ArenaAllocator(Arena *arena) : arena(arena) {}
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+        T *allocate(size_t count)
+        {
+            if (arena)
+            {
+                return static_cast<T *>(arena->allocate(count * sizeof(T), alignof(T) > cacheLineSize ? alignof(T) : cacheLineSize));
+            }
+            return std::allocator<T>().allocate(count);
+        }
+
+        void deallocate(T *pointer, size_t count)
+        {
+            if (!arena)
+            {
+                std::allocator<T>().deallocate(pointer, count);
+            }
+        }
+
+        template <typename U>
+        bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+        template <typename U>
+        bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+
+        Arena *arena = nullptr;
+    };
+
+    template <typename T>
+    using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+    // Drops the contents of `vector`; its storage is taken from `arena` from now on (nullptr: heap).
+    template <typename T>
+    void rebind(ArenaVector<T> &vector, Arena *arena)
+    {
+        vector = ArenaVector<T>(ArenaAllocator<T>(arena));
+    }
+
+    // Two arenas that take turns: the current generation is simulated from one while its
+    // offspring are built in the other. Starting the next generation resets the arena of the
+    // generation before the current one, whose data is no longer referenced.
+    class GenerationArena
+    {
+    public:
+        Arena &current() { return arenas[currentIndex]; }
+        const Arena &current() const { return arenas[currentIndex]; }
+        Arena &next() { return arenas[currentIndex ^ 1]; }
+
+        // resets the arena of the next generation and returns it
+        Arena &beginNext();
+        // the next generation becomes the current one
+        void advance() { currentIndex ^= 1; }
+        void reset();
+
+        size_t heapAllocations() const { return arenas[0].heapAllocations() + arenas[1].heapAllocations(); }
+
+    private:
+        Arena arenas[2];
+        int currentIndex = 0;
+    };
+}
@@ -0,0 +1,17 @@
+#include "brain.h"
+
+namespace sim
+{
+    const char *inputName(int input)
+    {
+        static const char *names[InputCount] = {
+            "TDe", "TGH", "TGL", "Vel", "Hdg", "Age", "Rnd", "Nrg", "Pop", "PGH", "PGL", "Osc", "Blk", "BLt"};
+        return (input >= 0 && input < InputCount) ? names[input] : "?";
+    }
+
+    const char *outputName(int output)
+    {
+        static const char *names[OutputCount] = {"Acc", "Rot"};
+        return (output >= 0 && output < OutputCount) ? names[output] : "?";
+    }
+}
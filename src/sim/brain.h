@@ -0,0 +1,45 @@
+#pragma once
+
+#include "genome.h"
+
+namespace sim
+{
+    // Input neurons (see README "Input Neurons")
+    enum Input
+    {
+        TDe, // target field density
+        TGH, // target field gradient along heading
+        TGL, // target field gradient lateral to heading
+        Vel, // velocity
+        Hdg, // heading
+        Age, // age
+        Rnd, // random value
+        Nrg, // energy
+        Pop, // population density over a NxN grid
+        PGH, // population gradient along heading
+        PGL, // population gradient lateral to heading
+        Osc, // oscillator
+        Blk, // blockage along heading
+        BLt, // blockage lateral
+        InputCount
+    };
+
+    // Output neurons (see README "Output Neurons")
+    enum Output
+    {
+        Acc, // accelerate
+        Rot, // rotate
+        OutputCount
+    };
+
+    const char *inputName(int input);
+    const char *outputName(int output);
+
+    namespace brain
+    {
+        // Neurons of a network share one value array: inputs, then hidden, then output neurons
+        inline int hiddenNeuron(int index) { return InputCount + index; }
+        inline int outputNeuron(int index, int hiddenCount) { return InputCount + hiddenCount + index; }
+        inline int neuronCount(int hiddenCount) { return InputCount + hiddenCount + OutputCount; }
+    }
+}
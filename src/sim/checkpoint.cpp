@@ -0,0 +1,396 @@
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "simulation.h"
+#include "util/fileview.h"
+
+namespace sim
+{
+    namespace checkpoint
+    {
+        static size_t alignOffset(size_t offset)
+        {
+            return (offset + columnAlignment - 1) / columnAlignment * columnAlignment;
+        }
+
+        // writes all parts with as few system calls as possible, continuing after partial writes
+        static bool writeAll(int fd, std::vector<iovec> &parts)
+        {
+            size_t first = 0;
+            while (first < parts.size())
+            {
+                ssize_t written = ::writev(fd, &parts[first], static_cast<int>(std::min<size_t>(parts.size() - first, IOV_MAX)));
+                if (written < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    return false;
+                }
+                size_t remaining = static_cast<size_t>(written);
+                while (first < parts.size() && remaining >= parts[first].iov_len)
+                {
+                    remaining -= parts[first].iov_len;
+                    first++;
+                }
+                if (remaining > 0)
+                {
+                    parts[first].iov_base = static_cast<char *>(parts[first].iov_base) + remaining;
+                    parts[first].iov_len -= remaining;
+                }
+            }
+            return true;
+        }
+
+        // value `index` of a column, which may lie at any address of the file
+        template <typename T>
+        static T element(const char *file, const Column &column, size_t index)
+        {
+            T value;
+            std::memcpy(&value, file + column.offset + index * sizeof(T), sizeof(T));
+            return value;
+        }
+
+        template <typename Vector>
+        static void readColumn(Vector &target, const char *file, const Column &column)
+        {
+            target.resize(column.size / sizeof(typename Vector::value_type));
+            if (column.size > 0)
+            {
+                std::memcpy(target.data(), file + column.offset, column.size);
+            }
+        }
+
+        // The stored networks are evaluated without further checks, so every index in them must lie
+        // within its array: programs must be laid out as compile() emits them, batches must refer to
+        // existing networks and weights.
+        static bool validNetworks(const char *file, const Column *columns, const Header &header)
+        {
+            const uint64_t networkCount = header.population;
+            const uint64_t opCount = columns[ProgramOps].size / sizeof(NeuronOp);
+            const uint64_t instructionCount = columns[ProgramSources].size / sizeof(uint16_t);
+            const uint32_t valueCount = uint32_t(network::valueCount(header.hiddenNeurons));
+            if (columns[ProgramWeights].size / sizeof(float) != instructionCount ||
+                element<uint32_t>(file, columns[ProgramBegin], 0) != 0 ||
+                element<uint32_t>(file, columns[ProgramBegin], networkCount) != opCount)
+            {
+                return false;
+            }
+            for (uint64_t i = 0; i < networkCount; i++)
+            {
+                // every network has at least its output ops
+                if (element<uint32_t>(file, columns[ProgramBegin], i) >= element<uint32_t>(file, columns[ProgramBegin], i + 1))
+                {
+                    return false;
+                }
+            }
+            // the instructions of all ops follow each other without gaps
+            uint64_t nextInstruction = 0;
+            for (uint64_t i = 0; i < opCount; i++)
+            {
+                NeuronOp op = element<NeuronOp>(file, columns[ProgramOps], i);
+                if (op.target >= valueCount || op.first != nextInstruction)
+                {
+                    return false;
+                }
+                nextInstruction += op.count;
+            }
+            if (nextInstruction != instructionCount)
+            {
+                return false;
+            }
+            for (uint64_t k = 0; k < instructionCount; k++)
+            {
+                if (element<uint16_t>(file, columns[ProgramSources], k) >= valueCount)
+                {
+                    return false;
+                }
+            }
+
+            const uint32_t lanes = header.batchLanes;
+            const uint64_t memberCount = columns[BatchMembers].size / sizeof(uint32_t);
+            const uint64_t weightCount = columns[BatchWeights].size / sizeof(float);
+            if (lanes != 8 && lanes != uint32_t(NetworkBatches::maxLanes))
+            {
+                return false;
+            }
+            for (uint64_t b = 0; b < columns[Batches].size / sizeof(NetworkBatches::Batch); b++)
+            {
+                NetworkBatches::Batch batch = element<NetworkBatches::Batch>(file, columns[Batches], b);
+                if (batch.network >= networkCount || batch.memberCount < 1 || batch.memberCount > lanes ||
+                    uint64_t(batch.firstMember) + batch.memberCount > memberCount)
+                {
+                    return false;
+                }
+                NeuronOp first = element<NeuronOp>(file, columns[ProgramOps], element<uint32_t>(file, columns[ProgramBegin], batch.network));
+                NeuronOp last = element<NeuronOp>(file, columns[ProgramOps], element<uint32_t>(file, columns[ProgramBegin], batch.network + 1) - 1);
+                if (uint64_t(batch.firstWeight) + uint64_t(last.first + last.count - first.first) * lanes > weightCount)
+                {
+                    return false;
+                }
+            }
+            for (ColumnId id : {BatchMembers, BatchSingles})
+            {
+                for (uint64_t i = 0; i < columns[id].size / sizeof(uint32_t); i++)
+                {
+                    if (element<uint32_t>(file, columns[id], i) >= networkCount)
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+    }
+
+    bool Simulation::saveCheckpoint(const std::string &fileName) const
+    {
+        using namespace checkpoint;
+
+        Header header = {};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.byteOrder = byteOrder;
+        header.columnCount = ColumnCount;
+        header.step = stepIndex;
+        header.cycle = cycleIndex;
+        header.population = population.size();
+        header.seed = simConfig.seed;
+        header.stepsPerCycle = simConfig.stepsPerCycle;
+        header.genomeLength = simConfig.genomeLength;
+        header.hiddenNeurons = simConfig.hiddenNeurons;
+        header.sensorGridSize = simConfig.sensorGridSize;
+        header.oscillatorPeriod = simConfig.oscillatorPeriod;
+        header.targetFieldResolution = simConfig.targetFieldResolution;
+        header.exactMovement = simConfig.exactMovement;
+        header.worldSize = simConfig.worldSize;
+        header.agentRadius = simConfig.agentRadius;
+        header.mutationRate = simConfig.mutationRate;
+        header.maxSpeed = simConfig.maxSpeed;
+        header.minSpeed = simConfig.minSpeed;
+        header.maxAcceleration = simConfig.maxAcceleration;
+        header.maxTurnRate = simConfig.maxTurnRate;
+        header.friction = simConfig.friction;
+        header.accelerationCost = simConfig.accelerationCost;
+        header.energyRecovery = simConfig.energyRecovery;
+        header.targetFieldFalloff = simConfig.targetFieldFalloff;
+        header.batchLanes = batches.lanes;
+
+        struct Source
+        {
+            const void *data;
+            uint32_t elementSize;
+            size_t count;
+        };
+        const Source sources[ColumnCount] = {
+            {population.x.data(), sizeof(float), population.x.size()},
+            {population.y.data(), sizeof(float), population.y.size()},
+            {population.velocity.data(), sizeof(float), population.velocity.size()},
+            {population.heading.data(), sizeof(float), population.heading.size()},
+            {population.energy.data(), sizeof(float), population.energy.size()},
+            {population.hidden.data(), sizeof(float), population.hidden.size()},
+            {population.genes.data(), sizeof(Gene), population.genes.size()},
+            {population.color.data(), sizeof(uint32_t), population.color.size()},
+            {population.lineage.data(), sizeof(uint32_t), population.lineage.size()},
+            {population.birthCycle.data(), sizeof(uint64_t), population.birthCycle.size()},
+            {simConfig.targets.data(), sizeof(float), simConfig.targets.size() * 3},
+            {networks.begin.data(), sizeof(uint32_t), networks.begin.size()},
+            {networks.ops.data(), sizeof(NeuronOp), networks.ops.size()},
+            {networks.source.data(), sizeof(uint16_t), networks.source.size()},
+            {networks.weight.data(), sizeof(float), networks.weight.size()},
+            {batches.batches.data(), sizeof(NetworkBatches::Batch), batches.batches.size()},
+            {batches.members.data(), sizeof(uint32_t), batches.members.size()},
+            {batches.weights.data(), sizeof(float), batches.weights.size()},
+            {batches.singles.data(), sizeof(uint32_t), batches.singles.size()},
+        };
+        static_assert(sizeof(Target) == 3 * sizeof(float), "targets are stored as 3 floats");
+        static_assert(std::is_trivially_copyable<NeuronOp>::value && std::is_trivially_copyable<NetworkBatches::Batch>::value,
+                      "networks are stored as they are in memory");
+
+        // the layout is known up front, so the file is written front to back in one go straight
+        // from the agent arrays
+        Column columns[ColumnCount];
+        static const char padding[columnAlignment] = {};
+        std::vector<iovec> parts;
+        parts.push_back({&header, sizeof(header)});
+        parts.push_back({columns, sizeof(columns)});
+        size_t offset = sizeof(header) + sizeof(columns);
+        for (uint32_t id = 0; id < ColumnCount; id++)
+        {
+            size_t start = alignOffset(offset);
+            parts.push_back({const_cast<char *>(padding), start - offset});
+            columns[id] = {id, sources[id].elementSize, start, uint64_t(sources[id].count) * sources[id].elementSize};
+            parts.push_back({const_cast<void *>(sources[id].data), columns[id].size});
+            offset = start + columns[id].size;
+        }
+
+        std::string temporaryName = fileName + ".tmp";
+        int fd = ::open(temporaryName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            std::cerr << "[ERROR] Could not create checkpoint " << temporaryName << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        bool written = writeAll(fd, parts) && ::fsync(fd) == 0;
+        int error = errno;
+        ::close(fd);
+        if (!written || std::rename(temporaryName.c_str(), fileName.c_str()) != 0)
+        {
+            std::cerr << "[ERROR] Could not write checkpoint " << fileName << ": " << std::strerror(written ? errno : error) << std::endl;
+            std::remove(temporaryName.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool Simulation::loadCheckpoint(const std::string &fileName)
+    {
+        using namespace checkpoint;
+
+        util::FileView view;
+        if (!view.open(fileName))
+        {
+            std::cerr << "[ERROR] Could not open checkpoint " << fileName << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        const char *file = view.data();
+        const size_t fileSize = view.size();
+
+        Header header = {};
+        std::memcpy(&header, file, std::min(sizeof(header), fileSize));
+        const char *problem = nullptr;
+        if (fileSize < sizeof(Header) || std::memcmp(header.magic, magic, sizeof(magic)) != 0)
+            problem = "not a checkpoint";
+        else if (header.version != version)
+            problem = "unsupported version";
+        else if (header.byteOrder != byteOrder)
+            problem = "written with a different byte order";
+        else if (header.columnCount != ColumnCount || fileSize < sizeof(Header) + sizeof(Column) * ColumnCount)
+            problem = "unexpected columns";
+        else if (header.genomeLength < 1 || header.hiddenNeurons < 1 || header.hiddenNeurons > 128 || header.stepsPerCycle < 1 ||
+                 header.step < 0 || header.step > header.stepsPerCycle || header.sensorGridSize < 1 || header.oscillatorPeriod < 1 ||
+                 header.targetFieldResolution < 1 || !(std::isfinite(header.worldSize) && header.worldSize > 0.0f) ||
+                 !(std::isfinite(header.agentRadius) && header.agentRadius > 0.0f))
+            problem = "invalid configuration";
+        // the agent columns must fit into the file, which also keeps the expected column sizes below from overflowing
+        else if (header.population > fileSize / sizeof(float) ||
+                 uint64_t(header.genomeLength) > fileSize / sizeof(Gene) / std::max<uint64_t>(header.population, 1))
+            problem = "population does not fit the file";
+
+        // every column must have the expected element size and length and lie within the file
+        Column columns[ColumnCount];
+        if (!problem)
+        {
+            std::memcpy(columns, file + sizeof(Header), sizeof(columns));
+            const uint64_t agents = header.population;
+            const uint64_t any = ~uint64_t(0); // a multiple of the element size
+            const uint64_t values[ColumnCount] = {agents, agents, agents, agents, agents, agents * header.hiddenNeurons,
+                                                  agents * header.genomeLength, agents, agents, agents, any,
+                                                  agents + 1, any, any, any, any, any, any, any};
+            const uint32_t elementSizes[ColumnCount] = {sizeof(float), sizeof(float), sizeof(float), sizeof(float), sizeof(float), sizeof(float),
+                                                        sizeof(Gene), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint64_t), sizeof(float),
+                                                        sizeof(uint32_t), sizeof(NeuronOp), sizeof(uint16_t), sizeof(float),
+                                                        sizeof(NetworkBatches::Batch), sizeof(uint32_t), sizeof(float), sizeof(uint32_t)};
+            for (uint32_t id = 0; id < ColumnCount && !problem; id++)
+            {
+                const Column &column = columns[id];
+                bool sizeMatches = values[id] != any ? column.size == values[id] * elementSizes[id]
+                                                     : column.size % (id == Targets ? sizeof(Target) : elementSizes[id]) == 0;
+                if (column.id != id || column.elementSize != elementSizes[id] || !sizeMatches ||
+                    column.offset % columnAlignment != 0 || column.offset > fileSize || column.size > fileSize - column.offset)
+                {
+                    problem = "damaged column table";
+                }
+            }
+            if (!problem && !validNetworks(file, columns, header))
+            {
+                problem = "damaged networks";
+            }
+        }
+        if (problem)
+        {
+            std::cerr << "[ERROR] Could not load checkpoint " << fileName << ": " << problem << std::endl;
+            return false;
+        }
+
+        Config config = simConfig;
+        config.population = header.population;
+        config.seed = header.seed;
+        config.stepsPerCycle = header.stepsPerCycle;
+        config.genomeLength = header.genomeLength;
+        config.hiddenNeurons = header.hiddenNeurons;
+        config.sensorGridSize = header.sensorGridSize;
+        config.oscillatorPeriod = header.oscillatorPeriod;
+        config.targetFieldResolution = header.targetFieldResolution;
+        config.exactMovement = header.exactMovement != 0;
+        config.worldSize = header.worldSize;
+        config.agentRadius = header.agentRadius;
+        config.mutationRate = header.mutationRate;
+        config.maxSpeed = header.maxSpeed;
+        config.minSpeed = header.minSpeed;
+        config.maxAcceleration = header.maxAcceleration;
+        config.maxTurnRate = header.maxTurnRate;
+        config.friction = header.friction;
+        config.accelerationCost = header.accelerationCost;
+        config.energyRecovery = header.energyRecovery;
+        config.targetFieldFalloff = header.targetFieldFalloff;
+        config.targets.resize(columns[Targets].size / sizeof(Target));
+        std::memcpy(config.targets.data(), file + columns[Targets].offset, columns[Targets].size);
+
+        if (!configure(config))
+        {
+            return false;
+        }
+        cycleIndex = header.cycle;
+        stepIndex = header.step;
+
+        population.add(header.population);
+        void *targets[ColumnCount] = {population.x.data(), population.y.data(), population.velocity.data(), population.heading.data(),
+                                      population.energy.data(), population.hidden.data(), population.genes.data(), population.color.data(),
+                                      population.lineage.data(), population.birthCycle.data(), nullptr};
+        for (uint32_t id = 0; id < Targets && header.population > 0; id++)
+        {
+            std::memcpy(targets[id], file + columns[id].offset, columns[id].size);
+        }
+
+        // the networks belong to the genomes of the current generation
+        Arena &arena = generations.current();
+        networks.bind(&arena);
+        batches.bind(&arena);
+        networks.clear(simConfig.hiddenNeurons);
+        readColumn(networks.begin, file, columns[ProgramBegin]);
+        readColumn(networks.ops, file, columns[ProgramOps]);
+        readColumn(networks.source, file, columns[ProgramSources]);
+        readColumn(networks.weight, file, columns[ProgramWeights]);
+        if (int(header.batchLanes) == NetworkBatches::lanesFor(Isa::Best))
+        {
+            batches.isa = supportedIsa(Isa::Best);
+            batches.lanes = int(header.batchLanes);
+            readColumn(batches.batches, file, columns[Batches]);
+            readColumn(batches.members, file, columns[BatchMembers]);
+            readColumn(batches.weights, file, columns[BatchWeights]);
+            readColumn(batches.singles, file, columns[BatchSingles]);
+        }
+        else
+        {
+            network::buildBatches(networks, batches);
+        }
+        view.close();
+
+        density.build(population.x.data(), population.y.data(), population.size());
+        return true;
+    }
+}
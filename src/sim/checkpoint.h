@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace sim
+{
+    // Binary checkpoint of a simulation, see Simulation::saveCheckpoint().
+    //
+    //   [ Header | Column x ColumnCount | padding | column data, each starting on a 64 byte boundary ]
+    //
+    // All values are stored in the byte order of the machine that wrote the file (checked with
+    // `byteOrder`), so a checkpoint is written straight from the agent arrays and loaded by
+    // mapping the file and copying the columns back. The random number generators are counter
+    // based: seed, cycle and step are their complete state.
+    //
+    // The compiled networks and their SIMD batches are stored as well, although they are derived
+    // from the genomes: compiling them again takes longer than reading them. Batches are only
+    // used if the reading machine evaluates as many lanes (`batchLanes`) as the writing one,
+    // otherwise they are rebuilt from the stored networks.
+    // Readers reject other versions; bump `version` whenever the layout or a column changes.
+    namespace checkpoint
+    {
+        const char magic[8] = {'A', 'I', 'A', 'G', 'E', 'N', 'T', 'S'};
+        const uint32_t version = 2;
+        const uint32_t byteOrder = 0x01020304;
+        const size_t columnAlignment = 64;
+
+        enum ColumnId : uint32_t
+        {
+            X,
+            Y,
+            Velocity,
+            Heading,
+            Energy,
+            Hidden,     // hiddenNeurons per agent
+            Genes,      // genomeLength per agent
+            Color,
+            Lineage,
+            BirthCycle,
+            Targets,    // x, y, radius per target
+            // NetworkPrograms, begin has population + 1 values
+            ProgramBegin,
+            ProgramOps,
+            ProgramSources,
+            ProgramWeights,
+            // NetworkBatches
+            Batches,
+            BatchMembers,
+            BatchWeights,
+            BatchSingles,
+            ColumnCount
+        };
+
+        struct Column
+        {
+            uint32_t id;
+            uint32_t elementSize; // bytes per value
+            uint64_t offset;      // from the start of the file
+            uint64_t size;        // bytes
+        };
+
+        struct Header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t byteOrder;
+            uint32_t columnCount;
+            int32_t step;
+            uint64_t cycle;
+
+            // the configuration the state belongs to, without the thread count
+            uint64_t population;
+            uint64_t seed;
+            int32_t stepsPerCycle;
+            int32_t genomeLength;
+            int32_t hiddenNeurons;
+            int32_t sensorGridSize;
+            int32_t oscillatorPeriod;
+            int32_t targetFieldResolution;
+            uint32_t exactMovement;
+            float worldSize;
+            float agentRadius;
+            float mutationRate;
+            float maxSpeed;
+            float minSpeed;
+            float maxAcceleration;
+            float maxTurnRate;
+            float friction;
+            float accelerationCost;
+            float energyRecovery;
+            float targetFieldFalloff;
+
+            uint32_t batchLanes;
+            uint32_t reserved;
+        };
+
+        static_assert(std::is_trivially_copyable<Header>::value && sizeof(Header) == 128, "checkpoint header layout changed");
+        static_assert(sizeof(Column) == 24, "checkpoint column layout changed");
+    }
+}
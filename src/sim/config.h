@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sim
+{
+    // Circular area in which agents may reproduce at the end of a cycle (rule 3).
+    // Every target also emits a field that permeates the world (rule 7).
+    struct Target
+    {
+        float x, y;
+        float radius;
+    };
+
+    // Parameters of a simulation run. Distances are in world units, the world is a square
+    // of edge length `worldSize` centered at the origin; rates are per simulation step.
+    struct Config
+    {
+        size_t population = 1000;
+        int stepsPerCycle = 300;
+        uint64_t seed = 1;
+        unsigned threads = 0; // worker threads of a simulation, 0: one per hardware thread
+
+        float worldSize = 4.0f;
+        float agentRadius = 0.03f; // same radius the agent shader draws
+
+        int genomeLength = 16;
+        int hiddenNeurons = 6;
+        float mutationRate = 0.05f; // probability of a single bit flip per offspring
+
+        int sensorGridSize = 5;    // N of the NxN sensor window and reach of the blockage sensors, in grid units
+        int oscillatorPeriod = 30; // steps
+
+        float maxSpeed = 0.01f;
+        float minSpeed = 0.0001f;  // agents slower than this are considered stationary
+        float maxAcceleration = 0.002f;
+        float maxTurnRate = 0.2f;  // radians
+        float friction = 0.05f;
+        float accelerationCost = 0.01f; // energy spent per step at full acceleration
+        float energyRecovery = 0.02f;   // energy gained per step while stationary
+        bool exactMovement = true;      // SIMD movement matches the scalar code bit for bit (no FMA)
+
+        float targetFieldFalloff = 1.0f; // standard deviation of the gaussian target field
+        int targetFieldResolution = 256; // nodes per side of the baked target field
+        std::vector<Target> targets = {{1.0f, 0.0f, 0.5f}};
+
+        // edge length of a grid cell, used by all grid based sensors
+        float gridUnit() const { return 2.0f * agentRadius; }
+    };
+}
@@ -0,0 +1,38 @@
+#include "cpu.h"
+
+namespace sim
+{
+    Isa detectIsa()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        static const Isa isa = __builtin_cpu_supports("avx512f")  ? Isa::AVX512
+                               : __builtin_cpu_supports("avx2")   ? Isa::AVX2
+                               : __builtin_cpu_supports("sse4.1") ? Isa::SSE41
+                                                                  : Isa::Scalar;
+        return isa;
+#else
+        return Isa::Scalar;
+#endif
+    }
+
+    const char *isaName(Isa isa)
+    {
+        switch (supportedIsa(isa))
+        {
+        case Isa::AVX512:
+            return "AVX-512";
+        case Isa::AVX2:
+            return "AVX2";
+        case Isa::SSE41:
+            return "SSE4.1";
+        default:
+            return "scalar";
+        }
+    }
+
+    Isa supportedIsa(Isa requested)
+    {
+        Isa supported = detectIsa();
+        return (requested == Isa::Best || int(requested) > int(supported)) ? supported : requested;
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+namespace sim
+{
+    // SIMD instruction sets with a dedicated code path, ordered by capability
+    enum class Isa
+    {
+        Scalar,
+        SSE41,
+        AVX2,
+        AVX512,
+        Best // the best instruction set supported by the CPU
+    };
+
+    Isa detectIsa();
+    const char *isaName(Isa isa);
+    // resolves Isa::Best and never returns an instruction set the CPU doesn't have
+    Isa supportedIsa(Isa requested);
+}
@@ -0,0 +1,157 @@
+#include "decoder.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIM_X86 1
+#endif
+
+namespace sim
+{
+    void ConnectionTable::resize(size_t genomes, int length)
+    {
+        genomeLength = length;
+        source.resize(genomes * length);
+        sink.resize(genomes * length);
+        weight.resize(genomes * length);
+    }
+
+    void ConnectionTable::bind(Arena *arena)
+    {
+        rebind(source, arena);
+        rebind(sink, arena);
+        rebind(weight, arena);
+    }
+
+    namespace genome
+    {
+        // IDs are 7 bit, so x % d equals x - d * ((x * m) >> 16) with m = ceil(2^16 / d) for all d < 512,
+        // which is exact and also available as a SIMD integer multiplication
+        static uint32_t modMultiplier(uint32_t divisor)
+        {
+            return (65536 + divisor - 1) / divisor;
+        }
+
+        static void decodeScalar(const Gene *genes, size_t total, int hiddenCount, uint16_t *source, uint16_t *sink, float *weight)
+        {
+            for (size_t i = 0; i < total; i++)
+            {
+                Connection connection = decode(genes[i]);
+                source[i] = connection.sourceType == SourceInput ? connection.sourceId % InputCount
+                                                                 : brain::hiddenNeuron(connection.sourceId % hiddenCount);
+                sink[i] = connection.sinkType == SinkOutput ? brain::outputNeuron(connection.sinkId % OutputCount, hiddenCount)
+                                                            : brain::hiddenNeuron(connection.sinkId % hiddenCount);
+                weight[i] = connection.weight;
+            }
+        }
+
+#ifdef SIM_X86
+        __attribute__((target("sse4.1"))) static inline __m128i mod128(__m128i x, __m128i divisor, __m128i multiplier)
+        {
+            __m128i quotient = _mm_srli_epi32(_mm_mullo_epi32(x, multiplier), 16);
+            return _mm_sub_epi32(x, _mm_mullo_epi32(quotient, divisor));
+        }
+
+        __attribute__((target("sse4.1"))) static void decodeSSE41(const Gene *genes, size_t total, int hiddenCount, uint16_t *source, uint16_t *sink, float *weight)
+        {
+            const __m128i idMask = _mm_set1_epi32(0x7f);
+            const __m128i one = _mm_set1_epi32(1);
+            const __m128i inputs = _mm_set1_epi32(InputCount), inputsMul = _mm_set1_epi32(modMultiplier(InputCount));
+            const __m128i outputs = _mm_set1_epi32(OutputCount), outputsMul = _mm_set1_epi32(modMultiplier(OutputCount));
+            const __m128i hidden = _mm_set1_epi32(hiddenCount), hiddenMul = _mm_set1_epi32(modMultiplier(hiddenCount));
+            const __m128i firstHidden = _mm_set1_epi32(brain::hiddenNeuron(0));
+            const __m128i firstOutput = _mm_set1_epi32(brain::outputNeuron(0, hiddenCount));
+            const __m128 scale = _mm_set1_ps(weightScale);
+
+            size_t i = 0;
+            for (; i + 4 <= total; i += 4)
+            {
+                __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(genes + i));
+
+                __m128i sourceId = _mm_and_si128(_mm_srli_epi32(g, 24), idMask);
+                __m128i sourceIsInput = _mm_cmpeq_epi32(_mm_srli_epi32(g, 31), one);
+                __m128i sourceIndex = _mm_blendv_epi8(_mm_add_epi32(firstHidden, mod128(sourceId, hidden, hiddenMul)),
+                                                      mod128(sourceId, inputs, inputsMul), sourceIsInput);
+
+                __m128i sinkId = _mm_and_si128(_mm_srli_epi32(g, 16), idMask);
+                __m128i sinkIsOutput = _mm_cmpeq_epi32(_mm_and_si128(_mm_srli_epi32(g, 23), one), one);
+                __m128i sinkIndex = _mm_blendv_epi8(_mm_add_epi32(firstHidden, mod128(sinkId, hidden, hiddenMul)),
+                                                    _mm_add_epi32(firstOutput, mod128(sinkId, outputs, outputsMul)), sinkIsOutput);
+
+                // sign extend the low 16 bits
+                __m128 w = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(g, 16), 16)), scale);
+                _mm_storeu_ps(weight + i, w);
+
+                __m128i packed = _mm_packus_epi32(sourceIndex, sinkIndex);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(source + i), packed);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(sink + i), _mm_srli_si128(packed, 8));
+            }
+            decodeScalar(genes + i, total - i, hiddenCount, source + i, sink + i, weight + i);
+        }
+
+        __attribute__((target("avx2"))) static inline __m256i mod256(__m256i x, __m256i divisor, __m256i multiplier)
+        {
+            __m256i quotient = _mm256_srli_epi32(_mm256_mullo_epi32(x, multiplier), 16);
+            return _mm256_sub_epi32(x, _mm256_mullo_epi32(quotient, divisor));
+        }
+
+        __attribute__((target("avx2"))) static void decodeAVX2(const Gene *genes, size_t total, int hiddenCount, uint16_t *source, uint16_t *sink, float *weight)
+        {
+            const __m256i idMask = _mm256_set1_epi32(0x7f);
+            const __m256i one = _mm256_set1_epi32(1);
+            const __m256i inputs = _mm256_set1_epi32(InputCount), inputsMul = _mm256_set1_epi32(modMultiplier(InputCount));
+            const __m256i outputs = _mm256_set1_epi32(OutputCount), outputsMul = _mm256_set1_epi32(modMultiplier(OutputCount));
+            const __m256i hidden = _mm256_set1_epi32(hiddenCount), hiddenMul = _mm256_set1_epi32(modMultiplier(hiddenCount));
+            const __m256i firstHidden = _mm256_set1_epi32(brain::hiddenNeuron(0));
+            const __m256i firstOutput = _mm256_set1_epi32(brain::outputNeuron(0, hiddenCount));
+            const __m256 scale = _mm256_set1_ps(weightScale);
+
+            size_t i = 0;
+            for (; i + 8 <= total; i += 8)
+            {
+                __m256i g = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(genes + i));
+
+                __m256i sourceId = _mm256_and_si256(_mm256_srli_epi32(g, 24), idMask);
+                __m256i sourceIsInput = _mm256_cmpeq_epi32(_mm256_srli_epi32(g, 31), one);
+                __m256i sourceIndex = _mm256_blendv_epi8(_mm256_add_epi32(firstHidden, mod256(sourceId, hidden, hiddenMul)),
+                                                         mod256(sourceId, inputs, inputsMul), sourceIsInput);
+
+                __m256i sinkId = _mm256_and_si256(_mm256_srli_epi32(g, 16), idMask);
+                __m256i sinkIsOutput = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_srli_epi32(g, 23), one), one);
+                __m256i sinkIndex = _mm256_blendv_epi8(_mm256_add_epi32(firstHidden, mod256(sinkId, hidden, hiddenMul)),
+                                                       _mm256_add_epi32(firstOutput, mod256(sinkId, outputs, outputsMul)), sinkIsOutput);
+
+                __m256 w = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(g, 16), 16)), scale);
+                _mm256_storeu_ps(weight + i, w);
+
+                // packus works per 128-bit lane: [source 0-3, sink 0-3 | source 4-7, sink 4-7]
+                __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(sourceIndex, sinkIndex), 0xd8);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(source + i), _mm256_castsi256_si128(packed));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(sink + i), _mm256_extracti128_si256(packed, 1));
+            }
+            decodeScalar(genes + i, total - i, hiddenCount, source + i, sink + i, weight + i);
+        }
+#endif
+
+        void decodeBatch(const Gene *genes, size_t count, int hiddenCount, ConnectionTable &table, Isa isa)
+        {
+            table.resize(count, table.genomeLength);
+            size_t total = count * table.genomeLength;
+
+            switch (supportedIsa(isa))
+            {
+#ifdef SIM_X86
+            case Isa::AVX512:
+            case Isa::AVX2:
+                decodeAVX2(genes, total, hiddenCount, table.source.data(), table.sink.data(), table.weight.data());
+                break;
+            case Isa::SSE41:
+                decodeSSE41(genes, total, hiddenCount, table.source.data(), table.sink.data(), table.weight.data());
+                break;
+#endif
+            default:
+                decodeScalar(genes, total, hiddenCount, table.source.data(), table.sink.data(), table.weight.data());
+                break;
+            }
+        }
+    }
+}
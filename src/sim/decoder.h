@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "arena.h"
+#include "genome.h"
+#include "brain.h"
+#include "cpu.h"
+
+namespace sim
+{
+    // Decoded connections of many genomes as structure of arrays. Connection `g` of genome `i`
+    // is at index `i * genomeLength + g`. Sources and sinks are neuron indices in the value
+    // array of a network (see brain::neuronCount()), with the IDs already reduced modulo the
+    // number of neurons of their type.
+    struct ConnectionTable
+    {
+        int genomeLength = 0;
+        ArenaVector<uint16_t> source;
+        ArenaVector<uint16_t> sink;
+        ArenaVector<float> weight;
+
+        void resize(size_t genomes, int length);
+        // drops the table, further storage is taken from `arena`
+        void bind(Arena *arena);
+        size_t genomes() const { return genomeLength ? weight.size() / genomeLength : 0; }
+    };
+
+    namespace genome
+    {
+        // Decodes `count` genomes of `table.genomeLength` genes each (stored back to back) into
+        // `table` in one pass. All instruction sets produce identical tables; AVX-512 uses the AVX2 path.
+        void decodeBatch(const Gene *genes, size_t count, int hiddenCount, ConnectionTable &table, Isa isa = Isa::Best);
+    }
+}
@@ -0,0 +1,41 @@
+#include "densitygrid.h"
+
+#include <algorithm>
+
+namespace sim
+{
+    void DensityGrid::configure(float worldSize, float cellSize)
+    {
+        inverseSize = 1.0f / cellSize;
+        halfWorld = 0.5f * worldSize;
+        cellsPerRow = static_cast<int>(std::ceil(worldSize / cellSize));
+        counts.assign(size_t(cellsPerRow) * cellsPerRow, 0);
+        summedArea.assign(size_t(cellsPerRow + 1) * (cellsPerRow + 1), 0);
+    }
+
+    void DensityGrid::build(const float *x, const float *y, size_t count)
+    {
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t i = 0; i < count; i++)
+        {
+            counts[cellIndex(cellX(x[i]), cellY(y[i]))]++;
+        }
+    }
+
+    void DensityGrid::buildSummedArea()
+    {
+        size_t stride = size_t(cellsPerRow) + 1;
+        for (int cy = 0; cy < cellsPerRow; cy++)
+        {
+            const int32_t *row = &counts[size_t(cy) * cellsPerRow];
+            const int32_t *above = &summedArea[size_t(cy) * stride];
+            int32_t *sums = &summedArea[size_t(cy + 1) * stride];
+            int32_t rowSum = 0;
+            for (int cx = 0; cx < cellsPerRow; cx++)
+            {
+                rowSum += row[cx];
+                sums[cx + 1] = above[cx + 1] + rowSum;
+            }
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sim
+{
+    // Number of agents per grid cell over the whole world.
+    //
+    // The counts are updated as agents move from one cell to another. buildSummedArea() turns them
+    // into a summed-area table, after which the number of agents in any rectangle of cells is
+    // four lookups, independent of its size.
+    class DensityGrid
+    {
+    public:
+        void configure(float worldSize, float cellSize);
+        void build(const float *x, const float *y, size_t count);
+        void buildSummedArea();
+
+        int cellX(float x) const { return clampCell(static_cast<int>(std::floor((x + halfWorld) * inverseSize))); }
+        int cellY(float y) const { return clampCell(static_cast<int>(std::floor((y + halfWorld) * inverseSize))); }
+
+        // keeps the counts current when an agent moves from (fromX,fromY) to (toX,toY); may be
+        // called from several threads at once
+        void move(float fromX, float fromY, float toX, float toY)
+        {
+            size_t from = cellIndex(cellX(fromX), cellY(fromY));
+            size_t to = cellIndex(cellX(toX), cellY(toY));
+            if (from != to)
+            {
+                __atomic_fetch_sub(&counts[from], 1, __ATOMIC_RELAXED);
+                __atomic_fetch_add(&counts[to], 1, __ATOMIC_RELAXED);
+            }
+        }
+
+        // agents in the cells [x0..x1] x [y0..y1] as of the last buildSummedArea(); cells outside of the world are empty
+        int windowSum(int x0, int y0, int x1, int y1) const
+        {
+            x0 = x0 < 0 ? 0 : x0;
+            y0 = y0 < 0 ? 0 : y0;
+            x1 = x1 >= cellsPerRow ? cellsPerRow - 1 : x1;
+            y1 = y1 >= cellsPerRow ? cellsPerRow - 1 : y1;
+            if (x0 > x1 || y0 > y1)
+            {
+                return 0;
+            }
+            size_t stride = size_t(cellsPerRow) + 1;
+            return summedArea[(y1 + 1) * stride + x1 + 1] - summedArea[y0 * stride + x1 + 1] -
+                   summedArea[(y1 + 1) * stride + x0] + summedArea[y0 * stride + x0];
+        }
+
+    private:
+        int clampCell(int cell) const { return cell < 0 ? 0 : (cell >= cellsPerRow ? cellsPerRow - 1 : cell); }
+        size_t cellIndex(int cellX, int cellY) const { return size_t(cellY) * cellsPerRow + cellX; }
+
+        float inverseSize = 1.0f;
+        float halfWorld = 0.0f;
+        int cellsPerRow = 0;
+
+        std::vector<int32_t> counts;
+        std::vector<int32_t> summedArea; // (cellsPerRow + 1)^2, first row and column are zero
+    };
+}
@@ -0,0 +1,84 @@
+#include "genome.h"
+
+#include <cmath>
+
+namespace sim
+{
+    namespace genome
+    {
+        Connection decode(Gene gene)
+        {
+            Connection connection;
+            connection.sourceType = (gene >> 31) & 0x01;
+            connection.sourceId = (gene >> 24) & 0x7f;
+            connection.sinkType = (gene >> 23) & 0x01;
+            connection.sinkId = (gene >> 16) & 0x7f;
+            connection.weight = static_cast<int16_t>(gene & 0xffff) * weightScale;
+            return connection;
+        }
+
+        Gene encode(const Connection &connection)
+        {
+            int32_t weight = static_cast<int32_t>(std::lround(connection.weight / weightScale));
+            weight = weight < -32768 ? -32768 : (weight > 32767 ? 32767 : weight);
+            return (Gene(connection.sourceType & 0x01) << 31) |
+                   (Gene(connection.sourceId & 0x7f) << 24) |
+                   (Gene(connection.sinkType & 0x01) << 23) |
+                   (Gene(connection.sinkId & 0x7f) << 16) |
+                   (Gene(weight) & 0xffff);
+        }
+
+        void randomize(Gene *genes, int length, const CounterRng &rng, uint32_t agent)
+        {
+            for (int i = 0; i < length; i += 4)
+            {
+                CounterRng::Block block = rng.block(agent, uint32_t(i / 4));
+                for (int w = 0; w < 4 && i + w < length; w++)
+                {
+                    genes[i + w] = block.word[w];
+                }
+            }
+        }
+
+        void inherit(const Gene *parent, Gene *child, int length, uint32_t flip)
+        {
+            // a mask instead of a branch keeps the copy a single vectorizable loop
+            int word = flip == noMutation ? -1 : int(flip / 32);
+            Gene bit = Gene(1) << (flip % 32);
+            for (int i = 0; i < length; i++)
+            {
+                child[i] = parent[i] ^ (i == word ? bit : 0);
+            }
+        }
+
+        uint32_t color(const Gene *genes, int length)
+        {
+            // fold the genome so a single mutation only changes a few bits of the color
+            Gene folded = 0;
+            for (int i = 0; i < length; i++)
+            {
+                folded ^= genes[i];
+            }
+            uint32_t r = (folded >> 24) & 0xff;
+            uint32_t g = (folded >> 16) & 0xff;
+            uint32_t b = (folded >> 8) & 0xff;
+            // keep agents readable on the light background
+            r = 32 + r * 3 / 4;
+            g = 32 + g * 3 / 4;
+            b = 32 + b * 3 / 4;
+            return r | (g << 8) | (b << 16) | (0xffu << 24);
+        }
+
+        uint64_t hash(const Gene *genes, int length)
+        {
+            // FNV-1a over the genes
+            uint64_t value = 14695981039346656037ull;
+            for (int i = 0; i < length; i++)
+            {
+                value ^= genes[i];
+                value *= 1099511628211ull;
+            }
+            return value;
+        }
+    }
+}
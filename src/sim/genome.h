@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+#include "random.h"
+
+namespace sim
+{
+    // A gene is a packed 32-bit connection between two neurons (see README "Gene encoding"):
+    //
+    //   bit 31     sourceType (0=Hidden, 1=Input)
+    //   bit 24-30  sourceID
+    //   bit 23     sinkType (0=Hidden, 1=Output)
+    //   bit 16-22  sinkID
+    //   bit 0-15   weight, signed, mapped to -4..4
+    typedef uint32_t Gene;
+
+    enum SourceType : uint8_t
+    {
+        SourceHidden = 0,
+        SourceInput = 1
+    };
+
+    enum SinkType : uint8_t
+    {
+        SinkHidden = 0,
+        SinkOutput = 1
+    };
+
+    struct Connection
+    {
+        uint8_t sourceType;
+        uint8_t sourceId;
+        uint8_t sinkType;
+        uint8_t sinkId;
+        float weight;
+    };
+
+    namespace genome
+    {
+        const float weightScale = 4.0f / 32768.0f;
+
+        Connection decode(Gene gene);
+        Gene encode(const Connection &connection);
+
+        // random genes from the blocks (agent, 0), (agent, 1), ... of `rng`
+        void randomize(Gene *genes, int length, const CounterRng &rng, uint32_t agent);
+        const uint32_t noMutation = ~0u;
+        // bit of a genome of `length` genes selected by `random`
+        inline uint32_t mutationBit(uint32_t random, int length) { return CounterRng::toRange(random, uint32_t(length) * 32); }
+        // copies the parent genome and flips bit `flip` (see mutationBit()) unless it is noMutation
+        void inherit(const Gene *parent, Gene *child, int length, uint32_t flip);
+
+        // RGBA8 color (first component in the lowest byte), related genomes get similar colors
+        uint32_t color(const Gene *genes, int length);
+        uint64_t hash(const Gene *genes, int length);
+    }
+}
@@ -0,0 +1,366 @@
+#include "headless.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "recorder.h"
+#include "simulation.h"
+#include "util/fileview.h"
+
+namespace sim
+{
+    bool isHeadless(int argc, char *argv[])
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::strcmp(argv[i], "--headless") == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void printUsage(const char *programName)
+    {
+        std::cout << "Usage: " << programName << " --headless [options]" << std::endl
+                  << "  --cycles N      number of cycles to simulate (default 100)" << std::endl
+                  << "  --agents N      population size" << std::endl
+                  << "  --steps N       steps per cycle" << std::endl
+                  << "  --genes N       genome length" << std::endl
+                  << "  --hidden N      number of hidden neurons" << std::endl
+                  << "  --world SIZE    edge length of the world" << std::endl
+                  << "  --mutation P    mutation probability per offspring" << std::endl
+                  << "  --seed N        random seed" << std::endl
+                  << "  --threads N     worker threads, 0 for one per hardware thread (default)" << std::endl
+                  << "  --metrics FILE  write per-cycle metrics as CSV to FILE instead of stdout" << std::endl
+                  << "  --checkpoint FILE     save the simulation to FILE every few cycles and at the end" << std::endl
+                  << "  --checkpoint-every N  cycles between checkpoints (default 10)" << std::endl
+                  << "  --resume FILE   continue a saved simulation; its configuration replaces the options above except --threads" << std::endl
+                  << "  --record FILE   record the agent trajectories of every step, see --replay of the viewer" << std::endl
+                  << "  --benchmark     time steps and reproduction from 1k to 1M agents at the density of the other options" << std::endl
+                  << "  --file-benchmark DIR  time reading files of 1 MB to 1 GB (written to DIR and removed) with and without mapping" << std::endl;
+    }
+
+    bool parseArguments(int argc, char *argv[], Config &config, HeadlessOptions &options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--headless")
+            {
+                continue;
+            }
+            if (arg == "--help")
+            {
+                return false;
+            }
+            if (arg == "--benchmark")
+            {
+                options.benchmark = true;
+                continue;
+            }
+            if (i + 1 >= argc)
+            {
+                std::cerr << "[ERROR] Missing value for argument " << arg << std::endl;
+                return false;
+            }
+
+            const char *value = argv[++i];
+            try
+            {
+                if (arg == "--cycles")
+                    options.cycles = std::stoull(value);
+                else if (arg == "--agents")
+                    config.population = std::stoull(value);
+                else if (arg == "--steps")
+                    config.stepsPerCycle = std::stoi(value);
+                else if (arg == "--genes")
+                    config.genomeLength = std::stoi(value);
+                else if (arg == "--hidden")
+                    config.hiddenNeurons = std::stoi(value);
+                else if (arg == "--world")
+                    config.worldSize = std::stof(value);
+                else if (arg == "--mutation")
+                    config.mutationRate = std::stof(value);
+                else if (arg == "--seed")
+                    config.seed = std::stoull(value);
+                else if (arg == "--threads")
+                    config.threads = static_cast<unsigned>(std::stoul(value));
+                else if (arg == "--metrics")
+                    options.metricsFileName = value;
+                else if (arg == "--checkpoint")
+                    options.checkpointFileName = value;
+                else if (arg == "--checkpoint-every")
+                    options.checkpointInterval = std::max<uint64_t>(std::stoull(value), 1);
+                else if (arg == "--resume")
+                    options.resumeFileName = value;
+                else if (arg == "--record")
+                    options.recordFileName = value;
+                else if (arg == "--file-benchmark")
+                    options.fileBenchmarkDirectory = value;
+                else
+                {
+                    std::cerr << "[ERROR] Unknown argument " << arg << std::endl;
+                    return false;
+                }
+            }
+            catch (const std::exception &)
+            {
+                std::cerr << "[ERROR] Invalid value for argument " << arg << ": " << value << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Step cost and reproduction throughput for populations from 1k to 1M agents. The world grows with the population so
+    // the density, and with it the work per agent, stays the same.
+    static int runBenchmark(const Config &baseConfig)
+    {
+        const int steps = 10;
+        float cellsPerSide = baseConfig.worldSize / baseConfig.gridUnit();
+        double density = baseConfig.population / double(cellsPerSide * cellsPerSide);
+
+        std::clog << "[INFO] Benchmark: " << steps << " steps per population, "
+                  << density * 100.0 << "% of the grid cells occupied" << std::endl;
+        std::cout << "agents,worldSize,threads,stepTime_ms,agentStep_ns,genomesPerSecond" << std::endl;
+
+        for (size_t agents = 1000; agents <= 1000000; agents *= 10)
+        {
+            Config config = baseConfig;
+            config.population = agents;
+            config.worldSize = std::ceil(std::sqrt(agents / density)) * config.gridUnit();
+
+            Simulation simulation(config);
+            if (!simulation.reset())
+            {
+                std::cerr << "[ERROR] Simulation initialization failed" << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            simulation.step(); // warm-up, allocates the per-step buffers
+            auto start = std::chrono::steady_clock::now();
+            for (int s = 0; s < steps; s++)
+            {
+                simulation.step();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / steps;
+            CycleStats stats = simulation.endCycle();
+            std::cout << agents << "," << config.worldSize << "," << simulation.threadCount() << "," << seconds * 1e3 << "," << seconds * 1e9 / agents << ","
+                      << stats.population / stats.reproductionSeconds << std::endl;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Reading a whole file of 1 MB to 1 GB into memory: the istreambuf_iterator loop util::readFile used, a FileView that
+    // reads the file and a mapped FileView. Every method sums all bytes, so mapped pages are really read. The file is in
+    // the page cache after it was written, this compares the cost of getting the bytes to the program, not the disk.
+    static int runFileBenchmark(const std::string &directory)
+    {
+        const int repeats = 3;
+        const std::string fileName = directory + "/file-benchmark.bin";
+
+        std::vector<char> block(size_t(1) << 20);
+        uint32_t state = 1;
+        for (char &c : block)
+        {
+            state = state * 1664525u + 1013904223u;
+            c = char(state >> 24);
+        }
+        auto checksum = [](const char *data, size_t size)
+        {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < size; i++)
+            {
+                sum += uint8_t(data[i]);
+            }
+            return sum;
+        };
+
+        std::clog << "[INFO] File benchmark in " << directory << ", best of " << repeats << std::endl;
+        std::cout << "bytes,method,open_ms,total_ms,MBps" << std::endl;
+        for (size_t bytes = block.size(); bytes <= size_t(1) << 30; bytes *= 4)
+        {
+            {
+                std::ofstream file(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+                for (size_t written = 0; written < bytes; written += block.size())
+                {
+                    file.write(block.data(), block.size());
+                }
+                if (!file)
+                {
+                    std::cerr << "[ERROR] Could not write " << fileName << std::endl;
+                    std::remove(fileName.c_str());
+                    return EXIT_FAILURE;
+                }
+            }
+
+            const char *methods[] = {"istreambuf_iterator", "FileView::read", "FileView::open"};
+            uint64_t expected = 0;
+            for (int method = 0; method < 3; method++)
+            {
+                double bestOpen = 1e30, bestTotal = 1e30;
+                for (int r = 0; r < repeats; r++)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    std::string content;
+                    util::FileView view;
+                    bool opened = true;
+                    if (method == 0)
+                    {
+                        std::ifstream ifs(fileName, std::ios::in);
+                        content.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+                    }
+                    else
+                    {
+                        opened = method == 1 ? view.read(fileName) : view.open(fileName);
+                    }
+                    auto loaded = std::chrono::steady_clock::now();
+                    uint64_t sum = method == 0 ? checksum(content.data(), content.size()) : checksum(view.data(), view.size());
+                    auto end = std::chrono::steady_clock::now();
+
+                    if (!opened || (expected && sum != expected))
+                    {
+                        std::cerr << "[ERROR] " << methods[method] << " did not read " << fileName << " correctly" << std::endl;
+                        std::remove(fileName.c_str());
+                        return EXIT_FAILURE;
+                    }
+                    expected = sum;
+                    bestOpen = std::min(bestOpen, std::chrono::duration<double>(loaded - start).count());
+                    bestTotal = std::min(bestTotal, std::chrono::duration<double>(end - start).count());
+                }
+                std::cout << bytes << "," << methods[method] << "," << bestOpen * 1e3 << "," << bestTotal * 1e3 << ","
+                          << bytes / bestTotal / 1e6 << std::endl;
+            }
+        }
+        std::remove(fileName.c_str());
+        return EXIT_SUCCESS;
+    }
+
+    int runHeadless(int argc, char *argv[])
+    {
+        Config config;
+        HeadlessOptions options;
+        if (!parseArguments(argc, argv, config, options))
+        {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        if (options.benchmark)
+        {
+            std::clog << "[INFO] SIMD instruction set: " << isaName(Isa::Best) << std::endl;
+            return runBenchmark(config);
+        }
+        if (!options.fileBenchmarkDirectory.empty())
+        {
+            return runFileBenchmark(options.fileBenchmarkDirectory);
+        }
+
+        std::ofstream metricsFile;
+        if (!options.metricsFileName.empty())
+        {
+            metricsFile.open(options.metricsFileName, std::ios::out | std::ios::trunc);
+            if (!metricsFile.is_open())
+            {
+                std::cerr << "[ERROR] Could not open metrics file " << options.metricsFileName << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        // only the CSV goes to stdout, all diagnostics go to std::clog
+        std::ostream &metrics = metricsFile.is_open() ? static_cast<std::ostream &>(metricsFile) : std::cout;
+
+        Simulation simulation(config);
+        if (!options.resumeFileName.empty())
+        {
+            auto loadStart = std::chrono::steady_clock::now();
+            if (!simulation.loadCheckpoint(options.resumeFileName))
+            {
+                return EXIT_FAILURE;
+            }
+            config = simulation.config();
+            std::clog << "[INFO] Resumed " << config.population << " agents at cycle " << simulation.cycle() << ", step " << simulation.stepInCycle()
+                      << " from " << options.resumeFileName << " in "
+                      << std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count() * 1000.0 << "ms" << std::endl;
+        }
+        else if (!simulation.reset())
+        {
+            std::cerr << "[ERROR] Simulation initialization failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+        // after a resume the configuration is the one of the checkpoint
+        std::clog << "[INFO] Headless simulation: " << config.population << " agents, "
+                  << config.stepsPerCycle << " steps per cycle, " << options.cycles << " cycles, seed " << config.seed << std::endl;
+        std::clog << "[INFO] SIMD instruction set: " << isaName(Isa::Best) << std::endl;
+        std::clog << "[INFO] Worker threads: " << simulation.threadCount() << std::endl;
+
+        TrajectoryRecorder recorder;
+        if (!options.recordFileName.empty())
+        {
+            if (!recorder.open(options.recordFileName, config))
+            {
+                return EXIT_FAILURE;
+            }
+            recorder.record(simulation);
+        }
+
+        metrics << "cycle,population,survivors,survivalRate,uniqueGenomes,meanConnections,groupingRatio,meanEnergy,cycleTime_ms,stepsPerSecond,genomesPerSecond,arenaBytes,arenaAllocations" << std::endl;
+
+        auto runStart = std::chrono::steady_clock::now();
+        for (uint64_t cycle = 0; cycle < options.cycles; cycle++)
+        {
+            auto cycleStart = std::chrono::steady_clock::now();
+            while (!simulation.cycleComplete())
+            {
+                simulation.step();
+                recorder.record(simulation);
+            }
+            CycleStats stats = simulation.endCycle();
+            recorder.record(simulation);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - cycleStart).count();
+
+            double survivalRate = stats.population ? double(stats.survivors) / stats.population : 0.0;
+            metrics << stats.cycle << "," << stats.population << "," << stats.survivors << ","
+                    << survivalRate << "," << stats.uniqueGenomes << "," << stats.meanConnections << "," << stats.groupingRatio << "," << stats.meanEnergy << ","
+                    << seconds * 1000.0 << "," << config.stepsPerCycle / seconds << "," << stats.population / stats.reproductionSeconds << ","
+                    << stats.arenaBytes << "," << stats.arenaAllocations << std::endl;
+
+            if (metricsFile.is_open())
+            {
+                std::clog << "[INFO] Cycle " << stats.cycle << ": " << stats.survivors << "/" << stats.population
+                          << " survivors, " << stats.uniqueGenomes << " unique genomes, "
+                          << stats.groupingRatio * 100.0f << "% batched networks, " << seconds * 1000.0 << "ms" << std::endl;
+            }
+
+            if (!options.checkpointFileName.empty() && ((cycle + 1) % options.checkpointInterval == 0 || cycle + 1 == options.cycles))
+            {
+                auto saveStart = std::chrono::steady_clock::now();
+                if (!simulation.saveCheckpoint(options.checkpointFileName))
+                {
+                    return EXIT_FAILURE;
+                }
+                std::clog << "[INFO] Saved cycle " << simulation.cycle() << " to " << options.checkpointFileName << " in "
+                          << std::chrono::duration<double>(std::chrono::steady_clock::now() - saveStart).count() * 1000.0 << "ms" << std::endl;
+            }
+        }
+
+        if (!recorder.close())
+        {
+            return EXIT_FAILURE;
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+        std::clog << "[INFO] Simulated " << options.cycles << " cycles in " << seconds << "s ("
+                  << options.cycles * config.stepsPerCycle / seconds << " steps/s)" << std::endl;
+        return EXIT_SUCCESS;
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "config.h"
+
+namespace sim
+{
+    struct HeadlessOptions
+    {
+        uint64_t cycles = 100;
+        std::string metricsFileName; // CSV metrics, stdout if empty
+        bool benchmark = false;      // time single steps for growing populations instead
+        std::string checkpointFileName; // saved every `checkpointInterval` cycles and at the end
+        uint64_t checkpointInterval = 10;
+        std::string resumeFileName; // checkpoint to continue from instead of a new world
+        std::string recordFileName; // trajectory of every step, see TrajectoryRecorder
+        std::string fileBenchmarkDirectory; // time reading files of 1 MB to 1 GB written there instead
+    };
+
+    bool isHeadless(int argc, char *argv[]);
+    bool parseArguments(int argc, char *argv[], Config &config, HeadlessOptions &options);
+    void printUsage(const char *programName);
+
+    // Runs the simulation flat out on the CPU without creating a window.
+    int runHeadless(int argc, char *argv[]);
+}
@@ -0,0 +1,165 @@
+#include "jobsystem.h"
+
+#include <algorithm>
+
+namespace sim
+{
+    JobSystem::~JobSystem()
+    {
+        stop();
+    }
+
+    void JobSystem::start(unsigned workers)
+    {
+        stop();
+        if (workers == 0)
+        {
+            workers = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        queues.reset(new Queue[workers]);
+        stopping = false;
+        generation = 0;
+        for (unsigned worker = 1; worker < workers; worker++)
+        {
+            threads.emplace_back(&JobSystem::workerLoop, this, worker);
+        }
+    }
+
+    void JobSystem::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+        threads.clear();
+    }
+
+    void JobSystem::run(size_t count, size_t chunkSize, Job function, void *functionContext)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        chunkSize = std::max<size_t>(chunkSize, 1);
+        if (threads.empty() || count <= chunkSize)
+        {
+            for (size_t begin = 0; begin < count; begin += chunkSize)
+            {
+                function(functionContext, begin, std::min(begin + chunkSize, count), 0);
+            }
+            return;
+        }
+
+        unsigned workers = workerCount();
+        size_t chunks = (count + chunkSize - 1) / chunkSize;
+        for (unsigned worker = 0; worker < workers; worker++)
+        {
+            uint64_t begin = chunks * worker / workers, end = chunks * (worker + 1) / workers;
+            queues[worker].range.store(begin | (end << 32), std::memory_order_relaxed);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = function;
+            context = functionContext;
+            itemCount = count;
+            chunkItems = chunkSize;
+            busy = unsigned(threads.size());
+            generation++;
+        }
+        wake.notify_all();
+
+        work(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return busy == 0; });
+    }
+
+    void JobSystem::workerLoop(unsigned worker)
+    {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+            {
+                return;
+            }
+            seen = generation;
+
+            lock.unlock();
+            work(worker);
+            lock.lock();
+
+            if (--busy == 0)
+            {
+                finished.notify_one();
+            }
+        }
+    }
+
+    void JobSystem::work(unsigned worker)
+    {
+        unsigned workers = workerCount();
+        uint32_t chunk;
+        while (true)
+        {
+            bool found = takeOwn(worker, chunk);
+            for (unsigned offset = 1; !found && offset < workers; offset++)
+            {
+                found = steal((worker + offset) % workers, chunk);
+            }
+            if (!found)
+            {
+                return;
+            }
+            size_t begin = size_t(chunk) * chunkItems;
+            job(context, begin, std::min(begin + chunkItems, itemCount), worker);
+        }
+    }
+
+    bool JobSystem::takeOwn(unsigned worker, uint32_t &chunk)
+    {
+        std::atomic<uint64_t> &range = queues[worker].range;
+        uint64_t current = range.load(std::memory_order_relaxed);
+        while (true)
+        {
+            uint32_t begin = uint32_t(current), end = uint32_t(current >> 32);
+            if (begin >= end)
+            {
+                return false;
+            }
+            if (range.compare_exchange_weak(current, uint64_t(begin + 1) | (uint64_t(end) << 32), std::memory_order_acquire))
+            {
+                chunk = begin;
+                return true;
+            }
+        }
+    }
+
+    bool JobSystem::steal(unsigned victim, uint32_t &chunk)
+    {
+        std::atomic<uint64_t> &range = queues[victim].range;
+        uint64_t current = range.load(std::memory_order_relaxed);
+        while (true)
+        {
+            uint32_t begin = uint32_t(current), end = uint32_t(current >> 32);
+            if (begin >= end)
+            {
+                return false;
+            }
+            if (range.compare_exchange_weak(current, uint64_t(begin) | (uint64_t(end - 1) << 32), std::memory_order_acquire))
+            {
+                chunk = end - 1;
+                return true;
+            }
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "aligned.h"
+
+namespace sim
+{
+    // Fixed set of worker threads for data-parallel loops.
+    //
+    // parallelFor() splits a range into chunks and deals them out to the workers in contiguous
+    // blocks. A worker takes chunks from the front of its own block and, once that is empty,
+    // steals from the back of the others, so uneven chunks still end at about the same time.
+    // The calling thread works as worker 0 and parallelFor() returns only when all chunks are
+    // done, which makes every call a barrier between two phases.
+    class JobSystem
+    {
+    public:
+        JobSystem() = default;
+        ~JobSystem();
+        JobSystem(const JobSystem &) = delete;
+        JobSystem &operator=(const JobSystem &) = delete;
+
+        // 0 uses one worker per hardware thread; 1 runs everything on the calling thread
+        void start(unsigned workers);
+        void stop();
+
+        unsigned workerCount() const { return unsigned(threads.size()) + 1; }
+
+        // calls function(begin, end, worker) for chunks of at most chunkSize items of [0, count)
+        template <typename Function>
+        void parallelFor(size_t count, size_t chunkSize, Function &&function)
+        {
+            using Type = std::remove_reference_t<Function>;
+            run(count, chunkSize, [](void *context, size_t begin, size_t end, unsigned worker) { (*static_cast<Type *>(context))(begin, end, worker); },
+                &function);
+        }
+
+    private:
+        using Job = void (*)(void *context, size_t begin, size_t end, unsigned worker);
+
+        // chunk range [begin, end) of a worker, begin in the low and end in the high 32 bits, so
+        // the owner and thieves claim chunks with a single compare-and-swap
+        struct alignas(cacheLineSize) Queue
+        {
+            std::atomic<uint64_t> range{0};
+        };
+
+        void run(size_t count, size_t chunkSize, Job job, void *context);
+        void workerLoop(unsigned worker);
+        void work(unsigned worker);
+        bool takeOwn(unsigned worker, uint32_t &chunk);
+        bool steal(unsigned victim, uint32_t &chunk);
+
+        std::vector<std::thread> threads;
+        std::unique_ptr<Queue[]> queues;
+
+        std::mutex mutex;
+        std::condition_variable wake, finished;
+        uint64_t generation = 0;
+        unsigned busy = 0;
+        bool stopping = false;
+
+        // the current phase, written before the workers are woken
+        Job job = nullptr;
+        void *context = nullptr;
+        size_t itemCount = 0;
+        size_t chunkItems = 1;
+    };
+}
@@ -0,0 +1,202 @@
+#include "movement.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "brain.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIM_X86 1
+#endif
+
+namespace sim
+{
+    namespace movement
+    {
+        const float pi = 3.14159265358979f;
+        const float twoPi = 2.0f * pi;
+
+        // Cody-Waite reduction to [-pi/4, pi/4] and the minimax polynomials of the Cephes sinf/cosf
+        const float twoOverPi = 0.636619772367581f;
+        const float halfPi1 = 1.5703125f;
+        const float halfPi2 = 4.837512969970703125e-4f;
+        const float halfPi3 = 7.54978995489188216e-8f;
+        const float sin0 = -1.9515295891e-4f, sin1 = 8.3321608736e-3f, sin2 = -1.6666654611e-1f;
+        const float cos0 = 2.443315711809948e-5f, cos1 = -1.388731625493765e-3f, cos2 = 4.166664568298827e-2f;
+
+        void sinCos(float angle, float *sine, float *cosine)
+        {
+            float quadrant = std::nearbyint(angle * twoOverPi);
+            float r = ((angle - quadrant * halfPi1) - quadrant * halfPi2) - quadrant * halfPi3;
+            float z = r * r;
+            float sinR = ((sin0 * z + sin1) * z + sin2) * (z * r) + r;
+            float cosR = ((cos0 * z + cos1) * z + cos2) * (z * z) + (-0.5f * z + 1.0f);
+
+            int q = static_cast<int>(quadrant);
+            float s = (q & 1) ? cosR : sinR;
+            float c = (q & 1) ? sinR : cosR;
+            *sine = (q & 2) ? -s : s;
+            *cosine = ((q + 1) & 2) ? -c : c;
+        }
+
+        // the scalar reference; the SIMD path performs the same operations in the same order
+        static void integrateScalar(const Config &config, AgentStore &agents, const float *actions, float *targetX, float *targetY, size_t begin, size_t end)
+        {
+            float limit = 0.5f * config.worldSize - config.agentRadius;
+            for (size_t i = begin; i < end; i++)
+            {
+                float acceleration = actions[i * OutputCount + Acc];
+                float rotation = actions[i * OutputCount + Rot];
+
+                float heading = agents.heading[i] + rotation * config.maxTurnRate;
+                heading = heading > pi ? heading - twoPi : (heading < -pi ? heading + twoPi : heading);
+                agents.heading[i] = heading;
+
+                float velocity = agents.velocity[i];
+                float energy = agents.energy[i];
+                float a = acceleration * config.maxAcceleration;
+                if (a > 0.0f)
+                {
+                    float cost = acceleration * config.accelerationCost;
+                    if (cost > energy)
+                    {
+                        a = a * (energy / cost);
+                        cost = energy;
+                    }
+                    energy = energy - cost;
+                    velocity = velocity + a;
+                }
+                else
+                {
+                    velocity = velocity * (1.0f - config.friction) + a;
+                }
+                velocity = std::min(std::max(velocity, 0.0f), config.maxSpeed);
+
+                targetX[i] = agents.x[i];
+                targetY[i] = agents.y[i];
+                if (velocity < config.minSpeed)
+                {
+                    agents.velocity[i] = 0.0f;
+                    agents.energy[i] = std::min(energy + config.energyRecovery, 1.0f);
+                    continue;
+                }
+                agents.energy[i] = energy;
+
+                float s, c;
+                sinCos(heading, &s, &c);
+                float x = agents.x[i] + c * velocity;
+                float y = agents.y[i] + s * velocity;
+                bool outside = x < -limit || x > limit || y < -limit || y > limit;
+                agents.velocity[i] = outside ? 0.0f : velocity;
+                targetX[i] = outside ? agents.x[i] : x;
+                targetY[i] = outside ? agents.y[i] : y;
+            }
+        }
+
+#ifdef SIM_X86
+        template <bool Fused>
+        __attribute__((target("avx2,fma"))) static inline __m256 multiplyAdd(__m256 a, __m256 b, __m256 c)
+        {
+            return Fused ? _mm256_fmadd_ps(a, b, c) : _mm256_add_ps(_mm256_mul_ps(a, b), c);
+        }
+
+        template <bool Fused>
+        __attribute__((target("avx2,fma"))) static inline void sinCosAVX2(__m256 angle, __m256 *sine, __m256 *cosine)
+        {
+            __m256 quadrant = _mm256_round_ps(_mm256_mul_ps(angle, _mm256_set1_ps(twoOverPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            __m256 r = _mm256_sub_ps(angle, _mm256_mul_ps(quadrant, _mm256_set1_ps(halfPi1)));
+            r = _mm256_sub_ps(r, _mm256_mul_ps(quadrant, _mm256_set1_ps(halfPi2)));
+            r = _mm256_sub_ps(r, _mm256_mul_ps(quadrant, _mm256_set1_ps(halfPi3)));
+            __m256 z = _mm256_mul_ps(r, r);
+
+            __m256 sinR = multiplyAdd<Fused>(_mm256_set1_ps(sin0), z, _mm256_set1_ps(sin1));
+            sinR = multiplyAdd<Fused>(sinR, z, _mm256_set1_ps(sin2));
+            sinR = multiplyAdd<Fused>(sinR, _mm256_mul_ps(z, r), r);
+            __m256 cosR = multiplyAdd<Fused>(_mm256_set1_ps(cos0), z, _mm256_set1_ps(cos1));
+            cosR = multiplyAdd<Fused>(cosR, z, _mm256_set1_ps(cos2));
+            cosR = multiplyAdd<Fused>(cosR, _mm256_mul_ps(z, z), multiplyAdd<Fused>(_mm256_set1_ps(-0.5f), z, _mm256_set1_ps(1.0f)));
+
+            // bit 0 of the quadrant swaps sine and cosine, bit 1 negates the sine and bit 1 of q + 1 the cosine
+            __m256i q = _mm256_cvtps_epi32(quadrant);
+            __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+            __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30));
+            __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+            *sine = _mm256_xor_ps(_mm256_blendv_ps(sinR, cosR, swap), sinSign);
+            *cosine = _mm256_xor_ps(_mm256_blendv_ps(cosR, sinR, swap), cosSign);
+        }
+
+        template <bool Fused>
+        __attribute__((target("avx2,fma"))) static size_t integrateAVX2(const Config &config, AgentStore &agents, const float *actions, float *targetX, float *targetY, size_t begin, size_t end)
+        {
+            const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+            const __m256 limit = _mm256_set1_ps(0.5f * config.worldSize - config.agentRadius);
+            const __m256 negativeLimit = _mm256_set1_ps(-(0.5f * config.worldSize - config.agentRadius));
+
+            size_t i = begin;
+            for (; i + 8 <= end; i += 8)
+            {
+                // actions are interleaved as Acc,Rot per agent
+                __m256 low = _mm256_loadu_ps(actions + i * OutputCount);
+                __m256 high = _mm256_loadu_ps(actions + i * OutputCount + 8);
+                __m256 acceleration = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+                __m256 rotation = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+
+                __m256 heading = multiplyAdd<false>(rotation, _mm256_set1_ps(config.maxTurnRate), _mm256_loadu_ps(&agents.heading[i]));
+                __m256 above = _mm256_cmp_ps(heading, _mm256_set1_ps(pi), _CMP_GT_OQ);
+                __m256 below = _mm256_cmp_ps(heading, _mm256_set1_ps(-pi), _CMP_LT_OQ);
+                heading = _mm256_blendv_ps(_mm256_blendv_ps(heading, _mm256_add_ps(heading, _mm256_set1_ps(twoPi)), below),
+                                           _mm256_sub_ps(heading, _mm256_set1_ps(twoPi)), above);
+                _mm256_storeu_ps(&agents.heading[i], heading);
+
+                __m256 velocity = _mm256_loadu_ps(&agents.velocity[i]);
+                __m256 energy = _mm256_loadu_ps(&agents.energy[i]);
+                __m256 a = _mm256_mul_ps(acceleration, _mm256_set1_ps(config.maxAcceleration));
+                __m256 cost = _mm256_mul_ps(acceleration, _mm256_set1_ps(config.accelerationCost));
+                __m256 accelerating = _mm256_cmp_ps(a, zero, _CMP_GT_OQ);
+                __m256 exhausted = _mm256_cmp_ps(cost, energy, _CMP_GT_OQ);
+                __m256 limitedA = _mm256_blendv_ps(a, _mm256_mul_ps(a, _mm256_div_ps(energy, cost)), exhausted);
+                __m256 limitedCost = _mm256_blendv_ps(cost, energy, exhausted);
+
+                __m256 coasting = multiplyAdd<false>(velocity, _mm256_set1_ps(1.0f - config.friction), a);
+                velocity = _mm256_blendv_ps(coasting, _mm256_add_ps(velocity, limitedA), accelerating);
+                energy = _mm256_blendv_ps(energy, _mm256_sub_ps(energy, limitedCost), accelerating);
+                velocity = _mm256_min_ps(_mm256_max_ps(velocity, zero), _mm256_set1_ps(config.maxSpeed));
+
+                __m256 stationary = _mm256_cmp_ps(velocity, _mm256_set1_ps(config.minSpeed), _CMP_LT_OQ);
+                __m256 recovered = _mm256_min_ps(_mm256_add_ps(energy, _mm256_set1_ps(config.energyRecovery)), one);
+                _mm256_storeu_ps(&agents.energy[i], _mm256_blendv_ps(energy, recovered, stationary));
+
+                __m256 sine, cosine;
+                sinCosAVX2<Fused>(heading, &sine, &cosine);
+                __m256 oldX = _mm256_loadu_ps(&agents.x[i]), oldY = _mm256_loadu_ps(&agents.y[i]);
+                __m256 x = multiplyAdd<Fused>(cosine, velocity, oldX);
+                __m256 y = multiplyAdd<Fused>(sine, velocity, oldY);
+                __m256 outside = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(x, negativeLimit, _CMP_LT_OQ), _mm256_cmp_ps(x, limit, _CMP_GT_OQ)),
+                                              _mm256_or_ps(_mm256_cmp_ps(y, negativeLimit, _CMP_LT_OQ), _mm256_cmp_ps(y, limit, _CMP_GT_OQ)));
+                __m256 still = _mm256_or_ps(stationary, outside);
+                _mm256_storeu_ps(&agents.velocity[i], _mm256_blendv_ps(velocity, zero, still));
+                _mm256_storeu_ps(targetX + i, _mm256_blendv_ps(x, oldX, still));
+                _mm256_storeu_ps(targetY + i, _mm256_blendv_ps(y, oldY, still));
+            }
+            return i;
+        }
+#endif
+
+        void integrate(const Config &config, AgentStore &agents, const float *actions, float *targetX, float *targetY,
+                       size_t begin, size_t end, Isa isa)
+        {
+            size_t first = begin;
+#ifdef SIM_X86
+            Isa supported = supportedIsa(isa);
+            if (supported == Isa::AVX2 || supported == Isa::AVX512)
+            {
+                first = config.exactMovement || !__builtin_cpu_supports("fma")
+                            ? integrateAVX2<false>(config, agents, actions, targetX, targetY, begin, end)
+                            : integrateAVX2<true>(config, agents, actions, targetX, targetY, begin, end);
+            }
+#endif
+            integrateScalar(config, agents, actions, targetX, targetY, first, end);
+        }
+    }
+}
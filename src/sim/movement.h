@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+#include "agentstore.h"
+#include "config.h"
+#include "cpu.h"
+
+namespace sim
+{
+    namespace movement
+    {
+        // sine and cosine for |angle| <= 2 pi; the same polynomial as the SIMD integrator
+        void sinCos(float angle, float *sine, float *cosine);
+
+        // Rules 4-6 without collisions, for the agents [begin, end): applies the Acc/Rot outputs
+        // (OutputCount floats per agent) to heading, velocity and energy and stores the position
+        // each agent moves to in targetX/targetY. Agents that stand still or would leave the
+        // world get velocity 0; all others keep a positive velocity until collisions are resolved.
+        //
+        // The AVX2 path updates 8 agents per instruction (AVX-512 uses it as well). With
+        // Config::exactMovement it is bit-identical to the scalar path, otherwise it may use FMA.
+        void integrate(const Config &config, AgentStore &agents, const float *actions, float *targetX, float *targetY,
+                       size_t begin, size_t end, Isa isa = Isa::Best);
+    }
+}
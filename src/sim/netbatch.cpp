@@ -0,0 +1,269 @@
+#include "netbatch.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIM_X86 1
+#endif
+
+namespace sim
+{
+    void NetworkBatches::bind(Arena *arena)
+    {
+        rebind(batches, arena);
+        rebind(members, arena);
+        rebind(weights, arena);
+        rebind(singles, arena);
+    }
+
+    float NetworkBatches::groupingRatio() const
+    {
+        size_t total = members.size() + singles.size();
+        return total ? float(members.size()) / total : 0.0f;
+    }
+
+    namespace network
+    {
+        static uint64_t topologyHash(const NetworkPrograms &programs, size_t index)
+        {
+            uint64_t hash = 14695981039346656037ull;
+            auto mix = [&hash](uint64_t value)
+            {
+                hash ^= value;
+                hash *= 1099511628211ull;
+            };
+            for (uint32_t op = programs.begin[index]; op < programs.begin[index + 1]; op++)
+            {
+                const NeuronOp &neuron = programs.ops[op];
+                mix((uint64_t(neuron.target) << 16) | neuron.count);
+                for (uint32_t k = neuron.first; k < neuron.first + neuron.count; k++)
+                {
+                    mix(programs.source[k]);
+                }
+            }
+            return hash;
+        }
+
+        static bool sameTopology(const NetworkPrograms &programs, size_t a, size_t b)
+        {
+            uint32_t opsA = programs.begin[a], opsB = programs.begin[b];
+            uint32_t count = programs.begin[a + 1] - opsA;
+            if (count != programs.begin[b + 1] - opsB)
+            {
+                return false;
+            }
+            for (uint32_t i = 0; i < count; i++)
+            {
+                const NeuronOp &x = programs.ops[opsA + i], &y = programs.ops[opsB + i];
+                if (x.target != y.target || x.count != y.count ||
+                    !std::equal(&programs.source[x.first], &programs.source[x.first] + x.count, &programs.source[y.first]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // the instructions of a network are contiguous, see compile()
+        static uint32_t firstInstruction(const NetworkPrograms &programs, size_t index)
+        {
+            return programs.ops[programs.begin[index]].first;
+        }
+
+        static uint32_t instructionCount(const NetworkPrograms &programs, size_t index)
+        {
+            const NeuronOp &last = programs.ops[programs.begin[index + 1] - 1];
+            return last.first + last.count - firstInstruction(programs, index);
+        }
+
+        void buildBatches(const NetworkPrograms &programs, NetworkBatches &batches, Isa isa, size_t minGroupSize)
+        {
+            batches.isa = supportedIsa(isa);
+            batches.lanes = NetworkBatches::lanesFor(batches.isa);
+            batches.batches.clear();
+            batches.members.clear();
+            batches.weights.clear();
+            batches.singles.clear();
+
+            size_t count = programs.networks();
+            batches.members.reserve(count);
+            batches.singles.reserve(count);
+            ArenaAllocator<uint32_t> allocator = batches.members.get_allocator();
+            ArenaVector<std::pair<uint64_t, uint32_t>> order(count, allocator);
+            for (size_t i = 0; i < count; i++)
+            {
+                order[i] = {topologyHash(programs, i), static_cast<uint32_t>(i)};
+            }
+            std::sort(order.begin(), order.end());
+
+            ArenaVector<uint32_t> group(allocator), rest(allocator), candidates(allocator);
+            for (size_t begin = 0; begin < count;)
+            {
+                size_t end = begin;
+                while (end < count && order[end].first == order[begin].first)
+                {
+                    end++;
+                }
+
+                // hash collisions are split off until every group has exactly one topology
+                candidates.clear();
+                for (size_t i = begin; i < end; i++)
+                {
+                    candidates.push_back(order[i].second);
+                }
+                while (!candidates.empty())
+                {
+                    group.clear();
+                    rest.clear();
+                    for (uint32_t network : candidates)
+                    {
+                        (sameTopology(programs, candidates.front(), network) ? group : rest).push_back(network);
+                    }
+                    candidates.swap(rest);
+
+                    if (group.size() < minGroupSize)
+                    {
+                        batches.singles.insert(batches.singles.end(), group.begin(), group.end());
+                        continue;
+                    }
+
+                    uint32_t instructions = instructionCount(programs, group.front());
+                    for (size_t first = 0; first < group.size(); first += batches.lanes)
+                    {
+                        NetworkBatches::Batch batch;
+                        batch.network = group.front();
+                        batch.firstMember = static_cast<uint32_t>(batches.members.size());
+                        batch.memberCount = static_cast<uint32_t>(std::min<size_t>(batches.lanes, group.size() - first));
+                        batch.firstWeight = static_cast<uint32_t>(batches.weights.size());
+
+                        batches.weights.resize(batches.weights.size() + size_t(instructions) * batches.lanes, 0.0f);
+                        for (uint32_t lane = 0; lane < batch.memberCount; lane++)
+                        {
+                            uint32_t network = group[first + lane];
+                            const float *weight = &programs.weight[firstInstruction(programs, network)];
+                            for (uint32_t k = 0; k < instructions; k++)
+                            {
+                                batches.weights[batch.firstWeight + k * batches.lanes + lane] = weight[k];
+                            }
+                            batches.members.push_back(network);
+                        }
+                        batches.batches.push_back(batch);
+                    }
+                }
+                begin = end;
+            }
+        }
+
+        // the program of a batch: ops and sources of its representative network, weights of all lanes
+        struct BatchProgram
+        {
+            const NeuronOp *op, *end;
+            const uint16_t *source;
+            const float *weight; // instruction k of lane l at weight[(k - first) * lanes + l]
+            uint32_t first;
+        };
+
+        static BatchProgram batchProgram(const NetworkPrograms &programs, const NetworkBatches &batches, const NetworkBatches::Batch &batch)
+        {
+            const NeuronOp *op = programs.ops.data() + programs.begin[batch.network];
+            return {op, programs.ops.data() + programs.begin[batch.network + 1], programs.source.data(),
+                    batches.weights.data() + batch.firstWeight, op->first};
+        }
+
+        template <int Lanes>
+        static void activate(const float *sum, float *target)
+        {
+            for (int lane = 0; lane < Lanes; lane++)
+            {
+                target[lane] = std::tanh(sum[lane]);
+            }
+        }
+
+        template <int Lanes>
+        static void runBatchScalar(const BatchProgram &program, float *values)
+        {
+            alignas(64) float sum[Lanes];
+            for (const NeuronOp *op = program.op; op != program.end; op++)
+            {
+                std::fill_n(sum, Lanes, 0.0f);
+                for (uint32_t k = op->first; k < op->first + op->count; k++)
+                {
+                    const float *weight = program.weight + (k - program.first) * Lanes;
+                    const float *value = values + program.source[k] * Lanes;
+                    for (int lane = 0; lane < Lanes; lane++)
+                    {
+                        sum[lane] += weight[lane] * value[lane];
+                    }
+                }
+                activate<Lanes>(sum, values + op->target * Lanes);
+            }
+        }
+
+#ifdef SIM_X86
+        // The whole loop carries the target attribute, so the intrinsics are inlined and the sum of an
+        // op stays in a register across its inputs. Multiply and add are separate (no FMA), so the
+        // results match the per-agent evaluation exactly.
+        __attribute__((target("avx2"))) static void runBatchAVX2(const BatchProgram &program, float *values)
+        {
+            alignas(32) float sum[8];
+            for (const NeuronOp *op = program.op; op != program.end; op++)
+            {
+                __m256 accumulator = _mm256_setzero_ps();
+                for (uint32_t k = op->first; k < op->first + op->count; k++)
+                {
+                    __m256 product = _mm256_mul_ps(_mm256_loadu_ps(program.weight + (k - program.first) * 8),
+                                                   _mm256_loadu_ps(values + program.source[k] * 8));
+                    accumulator = _mm256_add_ps(accumulator, product);
+                }
+                _mm256_store_ps(sum, accumulator);
+                activate<8>(sum, values + op->target * 8);
+            }
+        }
+
+        __attribute__((target("avx512f"))) static void runBatchAVX512(const BatchProgram &program, float *values)
+        {
+            alignas(64) float sum[16];
+            for (const NeuronOp *op = program.op; op != program.end; op++)
+            {
+                __m512 accumulator = _mm512_setzero_ps();
+                for (uint32_t k = op->first; k < op->first + op->count; k++)
+                {
+                    __m512 product = _mm512_mul_ps(_mm512_loadu_ps(program.weight + (k - program.first) * 16),
+                                                   _mm512_loadu_ps(values + program.source[k] * 16));
+                    accumulator = _mm512_add_ps(accumulator, product);
+                }
+                _mm512_store_ps(sum, accumulator);
+                activate<16>(sum, values + op->target * 16);
+            }
+        }
+#endif
+
+        void evaluateBatch(const NetworkPrograms &programs, const NetworkBatches &batches, size_t index, float *values)
+        {
+            BatchProgram program = batchProgram(programs, batches, batches.batches[index]);
+            switch (batches.isa)
+            {
+#ifdef SIM_X86
+            case Isa::AVX512:
+                runBatchAVX512(program, values);
+                break;
+            case Isa::AVX2:
+                runBatchAVX2(program, values);
+                break;
+#endif
+            default:
+                if (batches.lanes == 16)
+                {
+                    runBatchScalar<16>(program, values);
+                }
+                else
+                {
+                    runBatchScalar<8>(program, values);
+                }
+                break;
+            }
+        }
+    }
+}
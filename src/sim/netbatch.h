@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "arena.h"
+#include "cpu.h"
+#include "network.h"
+
+namespace sim
+{
+    // Networks with identical compiled topology (same ops and value indices, different weights)
+    // evaluated together, one agent per SIMD lane.
+    //
+    // A batch works on `lanes` value arrays interleaved as value[index * lanes + lane], and on the
+    // weights of all its members interleaved the same way, so every instruction of the shared
+    // program is one vector multiply-add over all lanes. Networks whose topology is shared by fewer
+    // than `minGroupSize` agents are evaluated one by one.
+    struct NetworkBatches
+    {
+        struct Batch
+        {
+            uint32_t network;      // representative network, provides ops and value indices
+            uint32_t firstMember;  // into members
+            uint32_t memberCount;  // 1..lanes, unused lanes have zero weights
+            uint32_t firstWeight;  // into weights
+        };
+
+        Isa isa = Isa::Scalar;
+        int lanes = 8;
+        static const int maxLanes = 16; // AVX-512
+        // batches built for one instruction set run on any other that uses the same number of lanes
+        static int lanesFor(Isa isa) { return supportedIsa(isa) == Isa::AVX512 ? maxLanes : 8; }
+        ArenaVector<Batch> batches;
+        ArenaVector<uint32_t> members; // network indices of the batched agents
+        ArenaVector<float> weights;
+        ArenaVector<uint32_t> singles; // networks evaluated one by one
+
+        // drops the batches, further storage (including the scratch of buildBatches()) is taken from `arena`
+        void bind(Arena *arena);
+        size_t batchedNetworks() const { return members.size(); }
+        // fraction of networks evaluated in batches
+        float groupingRatio() const;
+    };
+
+    namespace network
+    {
+        void buildBatches(const NetworkPrograms &programs, NetworkBatches &batches, Isa isa = Isa::Best, size_t minGroupSize = 4);
+
+        // Runs one step of a batch; `values` holds valueCount() * lanes interleaved floats, see evaluate()
+        void evaluateBatch(const NetworkPrograms &programs, const NetworkBatches &batches, size_t batch, float *values);
+    }
+}
@@ -0,0 +1,195 @@
+#include "network.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sim
+{
+    void NetworkPrograms::clear(int hidden)
+    {
+        hiddenCount = hidden;
+        begin.assign(1, 0);
+        ops.clear();
+        source.clear();
+        weight.clear();
+    }
+
+    void NetworkPrograms::bind(Arena *arena)
+    {
+        rebind(begin, arena);
+        rebind(ops, arena);
+        rebind(source, arena);
+        rebind(weight, arena);
+    }
+
+    namespace network
+    {
+        struct Edge
+        {
+            uint16_t source, sink; // neuron indices as produced by the decoder
+            float weight;
+        };
+
+        // memory for compiling one genome at a time: its edges and three flags per hidden neuron
+        struct CompileScratch
+        {
+            ArenaVector<Edge> edges;
+            ArenaVector<char> flags;
+
+            CompileScratch(const NetworkPrograms &programs, int connectionCount)
+                : edges(connectionCount, programs.source.get_allocator()),
+                  flags(3 * size_t(programs.hiddenCount), programs.source.get_allocator()) {}
+        };
+
+        static void compile(const uint16_t *source, const uint16_t *sink, const float *weight, int connectionCount, NetworkPrograms &programs, CompileScratch &scratch)
+        {
+            const int hiddenCount = programs.hiddenCount;
+            const int firstHidden = brain::hiddenNeuron(0);
+            const int firstOutput = brain::outputNeuron(0, hiddenCount);
+            auto isHidden = [&](int neuron)
+            { return neuron >= firstHidden && neuron < firstOutput; };
+
+            // merge duplicate connections, sorted by sink so every neuron's inputs are contiguous
+            Edge *edges = scratch.edges.data();
+            for (int i = 0; i < connectionCount; i++)
+            {
+                edges[i] = {source[i], sink[i], weight[i]};
+            }
+            std::sort(edges, edges + connectionCount, [](const Edge &a, const Edge &b)
+                      { return a.sink != b.sink ? a.sink < b.sink : a.source < b.source; });
+            size_t merged = 0;
+            for (int i = 0; i < connectionCount; i++)
+            {
+                if (merged > 0 && edges[merged - 1].sink == edges[i].sink && edges[merged - 1].source == edges[i].source)
+                {
+                    edges[merged - 1].weight += edges[i].weight;
+                }
+                else
+                {
+                    edges[merged++] = edges[i];
+                }
+            }
+            Edge *edgesEnd = std::remove_if(edges, edges + merged, [](const Edge &e)
+                                            { return e.weight == 0.0f; });
+
+            // prune until stable: a hidden neuron stays if it reaches an output and has an input
+            // that is alive; all others always evaluate to tanh(0) = 0 or are never read
+            char *alive = scratch.flags.data();
+            char *reachesOutput = alive + hiddenCount;
+            char *hasInput = reachesOutput + hiddenCount;
+            std::fill_n(alive, hiddenCount, 1);
+            bool changed = true;
+            while (changed)
+            {
+                std::fill_n(reachesOutput, 2 * hiddenCount, 0);
+                for (const Edge *edge = edges; edge != edgesEnd; edge++)
+                {
+                    if (isHidden(edge->sink))
+                    {
+                        hasInput[edge->sink - firstHidden] = 1;
+                    }
+                    if (isHidden(edge->source) && !isHidden(edge->sink))
+                    {
+                        reachesOutput[edge->source - firstHidden] = 1;
+                    }
+                }
+                // paths to an output through other hidden neurons
+                for (bool growing = true; growing;)
+                {
+                    growing = false;
+                    for (const Edge *edge = edges; edge != edgesEnd; edge++)
+                    {
+                        if (isHidden(edge->source) && isHidden(edge->sink) && reachesOutput[edge->sink - firstHidden] && !reachesOutput[edge->source - firstHidden])
+                        {
+                            reachesOutput[edge->source - firstHidden] = 1;
+                            growing = true;
+                        }
+                    }
+                }
+
+                changed = false;
+                for (int h = 0; h < hiddenCount; h++)
+                {
+                    char keep = alive[h] && reachesOutput[h] && hasInput[h];
+                    changed = changed || keep != alive[h];
+                    alive[h] = keep;
+                }
+                edgesEnd = std::remove_if(edges, edgesEnd, [&](const Edge &e)
+                                          { return (isHidden(e.source) && !alive[e.source - firstHidden]) ||
+                                                   (isHidden(e.sink) && !alive[e.sink - firstHidden]); });
+            }
+
+            // emit ops in topological order: hidden neurons (reading inputs and the previous step),
+            // then outputs (reading inputs and this step's hidden values); edges are already sorted by sink
+            const Edge *edge = edges;
+            for (int neuron = firstHidden; neuron < firstOutput + OutputCount; neuron++)
+            {
+                bool hiddenSink = isHidden(neuron);
+                if (hiddenSink && !alive[neuron - firstHidden])
+                {
+                    continue;
+                }
+
+                NeuronOp op;
+                op.target = hiddenSink ? currentHidden(neuron - firstHidden, hiddenCount) : output(neuron - firstOutput, hiddenCount);
+                op.first = static_cast<uint32_t>(programs.source.size());
+                for (; edge != edgesEnd && edge->sink == neuron; edge++)
+                {
+                    int value = edge->source;
+                    if (isHidden(edge->source))
+                    {
+                        value = hiddenSink ? previousHidden(edge->source - firstHidden) : currentHidden(edge->source - firstHidden, hiddenCount);
+                    }
+                    programs.source.push_back(static_cast<uint16_t>(value));
+                    programs.weight.push_back(edge->weight);
+                }
+                op.count = static_cast<uint16_t>(programs.source.size() - op.first);
+                programs.ops.push_back(op);
+            }
+            programs.begin.push_back(static_cast<uint32_t>(programs.ops.size()));
+        }
+
+        void compile(const uint16_t *source, const uint16_t *sink, const float *weight, int connectionCount, NetworkPrograms &programs)
+        {
+            CompileScratch scratch(programs, connectionCount);
+            compile(source, sink, weight, connectionCount, programs, scratch);
+        }
+
+        void compileAll(const ConnectionTable &table, int hiddenCount, NetworkPrograms &programs)
+        {
+            // reserve the upper bounds so the programs never leave grown-out copies behind in an
+            // arena: every live hidden neuron has an input, and merging only removes connections
+            size_t genomes = table.genomes();
+            size_t maxOps = size_t(std::min(hiddenCount, table.genomeLength) + OutputCount);
+            programs.begin.reserve(genomes + 1);
+            programs.ops.reserve(genomes * maxOps);
+            programs.source.reserve(genomes * table.genomeLength);
+            programs.weight.reserve(genomes * table.genomeLength);
+            programs.clear(hiddenCount);
+            CompileScratch scratch(programs, table.genomeLength);
+            for (size_t i = 0; i < genomes; i++)
+            {
+                size_t first = i * table.genomeLength;
+                compile(&table.source[first], &table.sink[first], &table.weight[first], table.genomeLength, programs, scratch);
+            }
+        }
+
+        void evaluate(const NetworkPrograms &programs, size_t index, float *values)
+        {
+            const NeuronOp *op = programs.ops.data() + programs.begin[index];
+            const NeuronOp *end = programs.ops.data() + programs.begin[index + 1];
+            const uint16_t *source = programs.source.data();
+            const float *weight = programs.weight.data();
+
+            for (; op != end; op++)
+            {
+                float sum = 0.0f;
+                for (uint32_t k = op->first; k < op->first + op->count; k++)
+                {
+                    sum += weight[k] * values[source[k]];
+                }
+                values[op->target] = std::tanh(sum);
+            }
+        }
+    }
+}
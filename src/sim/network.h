@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "arena.h"
+#include "brain.h"
+#include "decoder.h"
+
+namespace sim
+{
+    // One neuron of a compiled network: its new value is tanh() of the weighted sum over the
+    // `count` instructions starting at `first`.
+    struct NeuronOp
+    {
+        uint16_t target;
+        uint16_t count;
+        uint32_t first;
+    };
+
+    // Flat evaluation programs of many networks.
+    //
+    // A program works on one value array per network (see network::valueCount()):
+    //
+    //   [ inputs | hidden, previous step | hidden, this step | outputs ]
+    //
+    // Hidden neurons read other hidden neurons from the previous step, output neurons read the
+    // hidden neurons of this step; the compiler resolves this into plain value indices, so the
+    // evaluator runs the ops of a network linearly without looking at neuron types.
+    struct NetworkPrograms
+    {
+        int hiddenCount = 0;
+        ArenaVector<uint32_t> begin; // network i runs ops [begin[i], begin[i + 1])
+        ArenaVector<NeuronOp> ops;
+        ArenaVector<uint16_t> source; // instructions: value index and weight
+        ArenaVector<float> weight;
+
+        void clear(int hidden);
+        // drops the programs, further storage is taken from `arena`
+        void bind(Arena *arena);
+        size_t networks() const { return begin.empty() ? 0 : begin.size() - 1; }
+    };
+
+    namespace network
+    {
+        inline int previousHidden(int index) { return InputCount + index; }
+        inline int currentHidden(int index, int hiddenCount) { return InputCount + hiddenCount + index; }
+        inline int output(int index, int hiddenCount) { return InputCount + 2 * hiddenCount + index; }
+        inline int valueCount(int hiddenCount) { return InputCount + 2 * hiddenCount + OutputCount; }
+
+        // Compiles the decoded connections of one genome and appends the program to `programs`:
+        // duplicate source->sink connections are merged, connections that can't influence an output
+        // (hidden neurons without a path to an output or without any input) are pruned, and the
+        // remaining neurons are ordered topologically: hidden neurons first, then outputs.
+        // compileAll() keeps its scratch memory in the arena of `programs` for all genomes.
+        void compile(const uint16_t *source, const uint16_t *sink, const float *weight, int connectionCount, NetworkPrograms &programs);
+        void compileAll(const ConnectionTable &table, int hiddenCount, NetworkPrograms &programs);
+
+        // Runs one step of network `index`. `values` must hold the inputs and the previous hidden
+        // values; the new hidden values and the outputs are written to their slots.
+        void evaluate(const NetworkPrograms &programs, size_t index, float *values);
+    }
+}
@@ -0,0 +1,89 @@
+#include "occupancy.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace sim
+{
+    void OccupancyGrid::configure(float worldSize, float cellSize)
+    {
+        inverseSize = 1.0f / cellSize;
+        halfWorld = 0.5f * worldSize;
+        worldCells = worldSize * inverseSize;
+        cellsPerRow = static_cast<int>(std::ceil(worldSize / cellSize));
+        wordsPerRow = (cellsPerRow + 63) / 64;
+        words.assign(size_t(wordsPerRow) * cellsPerRow, 0);
+    }
+
+    void OccupancyGrid::build(const float *x, const float *y, size_t count)
+    {
+        std::fill(words.begin(), words.end(), 0);
+        for (size_t i = 0; i < count; i++)
+        {
+            int cellX = std::clamp(static_cast<int>(std::floor((x[i] + halfWorld) * inverseSize)), 0, cellsPerRow - 1);
+            int cellY = std::clamp(static_cast<int>(std::floor((y[i] + halfWorld) * inverseSize)), 0, cellsPerRow - 1);
+            words[size_t(cellY) * wordsPerRow + (cellX >> 6)] |= uint64_t(1) << (cellX & 63);
+        }
+    }
+
+    // DDA walk (Amanatides & Woo); t is the distance along the ray in grid units
+    float OccupancyGrid::castRay(float x, float y, float directionX, float directionY, int range) const
+    {
+        const float infinity = std::numeric_limits<float>::infinity();
+        float gridX = (x + halfWorld) * inverseSize, gridY = (y + halfWorld) * inverseSize;
+        int cellX = std::clamp(static_cast<int>(std::floor(gridX)), 0, cellsPerRow - 1);
+        int cellY = std::clamp(static_cast<int>(std::floor(gridY)), 0, cellsPerRow - 1);
+
+        int stepX = directionX > 0.0f ? 1 : -1, stepY = directionY > 0.0f ? 1 : -1;
+        float deltaX = directionX != 0.0f ? 1.0f / std::fabs(directionX) : infinity;
+        float deltaY = directionY != 0.0f ? 1.0f / std::fabs(directionY) : infinity;
+        float nextX = directionX != 0.0f ? (stepX > 0 ? cellX + 1 - gridX : gridX - cellX) * deltaX : infinity;
+        float nextY = directionY != 0.0f ? (stepY > 0 ? cellY + 1 - gridY : gridY - cellY) * deltaY : infinity;
+
+        // distance to the world border
+        float borderX = directionX != 0.0f ? (stepX > 0 ? worldCells - gridX : gridX) * deltaX : infinity;
+        float borderY = directionY != 0.0f ? (stepY > 0 ? worldCells - gridY : gridY) * deltaY : infinity;
+        float border = std::min(borderX, borderY);
+        float limit = std::min(border, float(range));
+
+        while (true)
+        {
+            float t;
+            if (nextX < nextY)
+            {
+                t = nextX;
+                nextX += deltaX;
+                cellX += stepX;
+            }
+            else
+            {
+                t = nextY;
+                nextY += deltaY;
+                cellY += stepY;
+            }
+            // the cell check guards against rounding when the world ends on a cell boundary
+            if (t >= limit || unsigned(cellX) >= unsigned(cellsPerRow) || unsigned(cellY) >= unsigned(cellsPerRow))
+            {
+                return border < float(range) ? 1.0f - std::floor(border) / range : 0.0f;
+            }
+            if (occupied(cellX, cellY))
+            {
+                return 1.0f - std::floor(t) / range;
+            }
+        }
+    }
+
+    void OccupancyGrid::castRays(const float *x, const float *y, const float *headingX, const float *headingY, size_t count,
+                                 Direction direction, int range, float *out, size_t outStride) const
+    {
+        // rotations by multiples of 90 degrees are exact
+        float c = direction == Ahead ? 1.0f : 0.0f;
+        float s = direction == Ahead ? 0.0f : (direction == Left ? 1.0f : -1.0f);
+        for (size_t i = 0; i < count; i++)
+        {
+            float directionX = headingX[i] * c - headingY[i] * s;
+            float directionY = headingY[i] * c + headingX[i] * s;
+            out[i * outStride] = castRay(x[i], y[i], directionX, directionY, range);
+        }
+    }
+}
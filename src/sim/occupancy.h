@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sim
+{
+    // One bit per grid cell that is set if at least one agent is in the cell, 64 cells per word.
+    // A row of the default world fits into two words, so a ray of a few cells touches only a
+    // handful of cache lines.
+    class OccupancyGrid
+    {
+    public:
+        // ray direction relative to the agent's heading
+        enum Direction
+        {
+            Ahead,
+            Left,
+            Right
+        };
+
+        void configure(float worldSize, float cellSize);
+        void build(const float *x, const float *y, size_t count);
+
+        bool occupied(int cellX, int cellY) const
+        {
+            return (words[size_t(cellY) * wordsPerRow + (cellX >> 6)] >> (cellX & 63)) & 1;
+        }
+
+        // Walks the cells along the ray from (x,y) in direction (directionX,directionY) for `range`
+        // cells. Returns 1 if the first obstacle is in a cell entered within one grid unit, down
+        // to 1/range for one entered within the last unit, and 0 if the path is free. The agent's
+        // own cell is not tested; the world border blocks.
+        float castRay(float x, float y, float directionX, float directionY, int range) const;
+
+        // castRay() for `count` agents in one pass; results are written to out[i * outStride]
+        void castRays(const float *x, const float *y, const float *headingX, const float *headingY, size_t count,
+                      Direction direction, int range, float *out, size_t outStride) const;
+
+    private:
+        float inverseSize = 1.0f;
+        float halfWorld = 0.0f;
+        float worldCells = 0.0f; // world edge length in cells, may end inside the last cell
+        int cellsPerRow = 0;
+        int wordsPerRow = 0;
+
+        std::vector<uint64_t> words;
+    };
+}
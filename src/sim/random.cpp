@@ -0,0 +1,141 @@
+#include "random.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIM_X86 1
+#endif
+
+namespace sim
+{
+    // multipliers and Weyl key increments of Philox4x32
+    const uint32_t philoxM0 = 0xD2511F53, philoxM1 = 0xCD9E8D57;
+    const uint32_t philoxW0 = 0x9E3779B9, philoxW1 = 0xBB67AE85;
+    const int philoxRounds = 10;
+
+    CounterRng::CounterRng(uint64_t seed, RandomStream stream, uint64_t cycle, uint32_t step)
+    {
+        key[0] = uint32_t(seed);
+        key[1] = uint32_t(seed >> 32) ^ uint32_t(cycle >> 32);
+        streamBits = uint32_t(stream) << 24;
+        cycleBits = uint32_t(cycle);
+        stepBits = step;
+    }
+
+    CounterRng::Block CounterRng::block(uint32_t agent, uint32_t index) const
+    {
+        uint32_t c0 = agent, c1 = streamBits | index, c2 = cycleBits, c3 = stepBits;
+        uint32_t k0 = key[0], k1 = key[1];
+        for (int round = 0; round < philoxRounds; round++)
+        {
+            uint64_t product0 = uint64_t(philoxM0) * c0;
+            uint64_t product1 = uint64_t(philoxM1) * c2;
+            c0 = uint32_t(product1 >> 32) ^ c1 ^ k0;
+            c1 = uint32_t(product1);
+            c2 = uint32_t(product0 >> 32) ^ c3 ^ k1;
+            c3 = uint32_t(product0);
+            k0 += philoxW0;
+            k1 += philoxW1;
+        }
+        return {{c0, c1, c2, c3}};
+    }
+
+#ifdef SIM_X86
+    // high and low 32 bits of the eight 32x32 bit products
+    __attribute__((target("avx2"))) static inline void multiplyHighLow(__m256i a, __m256i multiplier, __m256i *high, __m256i *low)
+    {
+        __m256i even = _mm256_mul_epu32(a, multiplier);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), multiplier);
+        *high = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xaa);
+        *low = _mm256_mullo_epi32(a, multiplier);
+    }
+
+    // blocks firstBlock.. with their four words each, as uniform floats or raw words; returns the
+    // number of blocks done, a multiple of 8
+    template <bool Uniform>
+    __attribute__((target("avx2"))) static size_t generateAVX2(const uint32_t *key, uint32_t c1, uint32_t c2, uint32_t c3, uint32_t firstBlock, size_t blocks, void *out)
+    {
+        const __m256i m0 = _mm256_set1_epi32(int(philoxM0)), m1 = _mm256_set1_epi32(int(philoxM1));
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256 scale = _mm256_set1_ps(1.0f / 16777216.0f);
+        size_t i = 0;
+        for (; i + 8 <= blocks; i += 8)
+        {
+            __m256i x0 = _mm256_add_epi32(_mm256_set1_epi32(int(firstBlock + uint32_t(i))), lanes);
+            __m256i x1 = _mm256_set1_epi32(int(c1)), x2 = _mm256_set1_epi32(int(c2)), x3 = _mm256_set1_epi32(int(c3));
+            uint32_t k0 = key[0], k1 = key[1];
+            for (int round = 0; round < philoxRounds; round++)
+            {
+                __m256i high0, low0, high1, low1;
+                multiplyHighLow(x0, m0, &high0, &low0);
+                multiplyHighLow(x2, m1, &high1, &low1);
+                x0 = _mm256_xor_si256(_mm256_xor_si256(high1, x1), _mm256_set1_epi32(int(k0)));
+                x1 = low1;
+                x2 = _mm256_xor_si256(_mm256_xor_si256(high0, x3), _mm256_set1_epi32(int(k1)));
+                x3 = low0;
+                k0 += philoxW0;
+                k1 += philoxW1;
+            }
+
+            // transpose, so the four words of each block are adjacent
+            __m256i t0 = _mm256_unpacklo_epi32(x0, x1), t1 = _mm256_unpackhi_epi32(x0, x1);
+            __m256i t2 = _mm256_unpacklo_epi32(x2, x3), t3 = _mm256_unpackhi_epi32(x2, x3);
+            __m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+            __m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+            __m256i words[4] = {_mm256_permute2x128_si256(u0, u1, 0x20), _mm256_permute2x128_si256(u2, u3, 0x20),
+                                _mm256_permute2x128_si256(u0, u1, 0x31), _mm256_permute2x128_si256(u2, u3, 0x31)};
+
+            for (int w = 0; w < 4; w++)
+            {
+                if (Uniform)
+                {
+                    // same conversion as toUniform(), exact in both
+                    float *uniform = static_cast<float *>(out) + i * 4 + 8 * w;
+                    _mm256_storeu_ps(uniform, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(words[w], 8)), scale));
+                }
+                else
+                {
+                    uint32_t *raw = static_cast<uint32_t *>(out) + i * 4 + 8 * w;
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(raw), words[w]);
+                }
+            }
+        }
+        return i;
+    }
+#endif
+
+    void CounterRng::uniformBatch(uint32_t firstAgent, size_t count, float *out, Isa isa) const
+    {
+        size_t i = 0;
+#ifdef SIM_X86
+        Isa supported = supportedIsa(isa);
+        if (supported == Isa::AVX2 || supported == Isa::AVX512)
+        {
+            for (; i < count && ((firstAgent + i) & 3) != 0; i++)
+            {
+                out[i] = uniform(firstAgent + uint32_t(i));
+            }
+            i += 4 * generateAVX2<true>(key, streamBits | uniformIndex, cycleBits, stepBits, (firstAgent + uint32_t(i)) >> 2, (count - i) / 4, out + i);
+        }
+#endif
+        for (; i < count; i++)
+        {
+            out[i] = uniform(firstAgent + uint32_t(i));
+        }
+    }
+
+    void CounterRng::blockBatch(uint32_t firstAgent, size_t count, Block *out, Isa isa) const
+    {
+        size_t i = 0;
+#ifdef SIM_X86
+        Isa supported = supportedIsa(isa);
+        if (supported == Isa::AVX2 || supported == Isa::AVX512)
+        {
+            i = generateAVX2<false>(key, streamBits, cycleBits, stepBits, firstAgent, count, out);
+        }
+#endif
+        for (; i < count; i++)
+        {
+            out[i] = block(firstAgent + uint32_t(i));
+        }
+    }
+}
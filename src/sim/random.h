@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cpu.h"
+
+namespace sim
+{
+    // independent sequences of random numbers, one per purpose
+    enum class RandomStream : uint32_t
+    {
+        Sensor,    // Rnd input neuron
+        Placement, // cell and heading at the start of a cycle
+        Mutation,
+        Genome     // random genomes at the start and after an extinction
+    };
+
+    // Counter-based random numbers (Philox4x32-10, Salmon et al., "Parallel Random Numbers: As
+    // Easy as 1, 2, 3", 2011).
+    //
+    // Every block of four 32-bit numbers is a pure function of (seed, stream, cycle, step, agent,
+    // index), so there is no generator state to share between threads and a run reproduces
+    // exactly, regardless of the number of threads or the order in which agents are processed.
+    class CounterRng
+    {
+    public:
+        struct Block
+        {
+            uint32_t word[4];
+        };
+
+        CounterRng(uint64_t seed, RandomStream stream, uint64_t cycle, uint32_t step = 0);
+
+        // `index` numbers several blocks of the same agent, 0..2^24-2
+        Block block(uint32_t agent, uint32_t index = 0) const;
+        // block(agent) for `count` consecutive agents, 8 at once with AVX2
+        void blockBatch(uint32_t firstAgent, size_t count, Block *out, Isa isa = Isa::Best) const;
+
+        // one number per agent, four agents share a block
+        float uniform(uint32_t agent) const { return toUniform(block(agent >> 2, uniformIndex).word[agent & 3]); }
+        // uniform(agent) for `count` consecutive agents; AVX2 generates 8 blocks (32 numbers) at once
+        void uniformBatch(uint32_t firstAgent, size_t count, float *out, Isa isa = Isa::Best) const;
+
+        // 0..1 (exclusive) with 24 bit resolution
+        static float toUniform(uint32_t word) { return float(word >> 8) * (1.0f / 16777216.0f); }
+        // 0..range-1 by multiply-shift; the bias is below range / 2^32
+        static uint32_t toRange(uint32_t word, uint32_t range) { return uint32_t((uint64_t(word) * range) >> 32); }
+
+    private:
+        static const uint32_t uniformIndex = 0xffffff; // keeps uniform() apart from block(agent, index)
+
+        uint32_t key[2];
+        uint32_t streamBits; // counter word 1 without the index
+        uint32_t cycleBits;  // counter word 2
+        uint32_t stepBits;   // counter word 3
+    };
+}
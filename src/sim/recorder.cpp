@@ -0,0 +1,461 @@
+#include "recorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "simulation.h"
+
+namespace sim
+{
+    namespace trajectory
+    {
+        const float turn = 6.28318530717959f;
+        // frames in flight between the simulation and the writer
+        const size_t poolSize = 8;
+
+        static uint16_t quantizePosition(float value, float worldSize)
+        {
+            return static_cast<uint16_t>(std::lround(std::clamp(value / worldSize + 0.5f, 0.0f, 1.0f) * 65535.0f));
+        }
+
+        static float dequantizePosition(uint16_t value, float worldSize)
+        {
+            return (value / 65535.0f - 0.5f) * worldSize;
+        }
+
+        // -pi..pi maps onto the full 16 bit range and wraps around
+        static uint16_t quantizeHeading(float heading)
+        {
+            return static_cast<uint16_t>(std::lround(heading / turn * 65536.0f));
+        }
+
+        static float dequantizeHeading(uint16_t value)
+        {
+            return static_cast<int16_t>(value) * (turn / 65536.0f);
+        }
+
+        // zigzag encoded difference modulo 2^16, small steps in either direction take one or two bytes
+        static void putDelta(std::vector<uint8_t> &out, uint16_t value, uint16_t previous)
+        {
+            int16_t delta = static_cast<int16_t>(uint16_t(value - previous));
+            uint32_t zigzag = uint16_t(uint16_t(delta) << 1 ^ uint16_t(delta >> 15));
+            while (zigzag >= 0x80)
+            {
+                out.push_back(uint8_t(zigzag | 0x80));
+                zigzag >>= 7;
+            }
+            out.push_back(uint8_t(zigzag));
+        }
+
+        static void putVarint(std::vector<uint8_t> &out, uint32_t value)
+        {
+            while (value >= 0x80)
+            {
+                out.push_back(uint8_t(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(uint8_t(value));
+        }
+
+        static bool getVarint(const uint8_t *&cursor, const uint8_t *end, uint32_t &value)
+        {
+            value = 0;
+            for (int shift = 0; shift < 35 && cursor < end; shift += 7)
+            {
+                uint8_t byte = *cursor++;
+                value |= uint32_t(byte & 0x7f) << shift;
+                if (!(byte & 0x80))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static bool getDelta(const uint8_t *&cursor, const uint8_t *end, uint16_t &value)
+        {
+            uint32_t zigzag;
+            if (!getVarint(cursor, end, zigzag))
+            {
+                return false;
+            }
+            value = uint16_t(value + uint16_t((zigzag >> 1) ^ (0u - (zigzag & 1))));
+            return true;
+        }
+    }
+
+    TrajectoryRecorder::~TrajectoryRecorder()
+    {
+        close();
+    }
+
+    bool TrajectoryRecorder::open(const std::string &fileName, const Config &config, size_t framesPerChunk)
+    {
+        close();
+        file.open(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            std::cerr << "[ERROR] Could not create trajectory file " << fileName << std::endl;
+            return false;
+        }
+        name = fileName;
+
+        header = {};
+        std::memcpy(header.magic, trajectory::magic, sizeof(trajectory::magic));
+        header.version = trajectory::version;
+        header.framesPerChunk = static_cast<uint32_t>(std::max<size_t>(framesPerChunk, 1));
+        header.agents = config.population;
+        header.worldSize = config.worldSize;
+        header.agentRadius = config.agentRadius;
+        header.targetCount = static_cast<uint32_t>(config.targets.size());
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(config.targets.data()), config.targets.size() * sizeof(Target));
+        fileOffset = sizeof(header) + config.targets.size() * sizeof(Target);
+
+        pool.assign(trajectory::poolSize, TrajectoryFrame());
+        freeFrames.clear();
+        for (TrajectoryFrame &frame : pool)
+        {
+            freeFrames.push_back(&frame);
+        }
+        pending.clear();
+        index.clear();
+        chunkHeader = {};
+        closing = failed = false;
+        frames = stalls = writtenFrames = 0;
+        writer = std::thread(&TrajectoryRecorder::writeLoop, this);
+        return true;
+    }
+
+    void TrajectoryRecorder::record(const Simulation &simulation)
+    {
+        TrajectoryFrame *frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!isOpen() || failed)
+            {
+                return;
+            }
+            if (freeFrames.empty())
+            {
+                stalls++;
+                changed.wait(lock, [this] { return !freeFrames.empty(); });
+            }
+            frame = freeFrames.back();
+            freeFrames.pop_back();
+        }
+
+        const AgentStore &agents = simulation.agents();
+        frame->cycle = simulation.cycle();
+        frame->step = simulation.stepInCycle();
+        frame->x.assign(agents.x.begin(), agents.x.end());
+        frame->y.assign(agents.y.begin(), agents.y.end());
+        frame->heading.assign(agents.heading.begin(), agents.heading.end());
+        frame->color.assign(agents.color.begin(), agents.color.end());
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(frame);
+            frames++;
+        }
+        changed.notify_all();
+    }
+
+    void TrajectoryRecorder::writeLoop()
+    {
+        while (true)
+        {
+            TrajectoryFrame *frame;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this] { return !pending.empty() || closing; });
+                if (pending.empty())
+                {
+                    break;
+                }
+                frame = pending.front();
+                pending.pop_front();
+            }
+
+            encode(*frame);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                freeFrames.push_back(frame);
+                failed = failed || !file.good();
+            }
+            changed.notify_all();
+        }
+        flushChunk();
+    }
+
+    void TrajectoryRecorder::encode(const TrajectoryFrame &frame)
+    {
+        size_t agents = frame.x.size();
+        if (chunkHeader.frameCount > 0 &&
+            (frame.cycle != chunkHeader.cycle || agents != chunkHeader.agentCount || chunkHeader.frameCount >= header.framesPerChunk))
+        {
+            flushChunk();
+        }
+
+        // a chunk starts with the colors and a frame that is stored against zero
+        if (chunkHeader.frameCount == 0)
+        {
+            chunkHeader = {frame.cycle, 0, static_cast<uint32_t>(agents), 0};
+            chunk.resize(agents * sizeof(uint32_t));
+            std::memcpy(chunk.data(), frame.color.data(), chunk.size());
+            previous.assign(agents * 3, 0);
+        }
+
+        trajectory::putVarint(chunk, static_cast<uint32_t>(frame.step));
+        uint16_t *last = previous.data();
+        for (size_t i = 0; i < agents; i++, last += 3)
+        {
+            uint16_t x = trajectory::quantizePosition(frame.x[i], header.worldSize);
+            uint16_t y = trajectory::quantizePosition(frame.y[i], header.worldSize);
+            uint16_t heading = trajectory::quantizeHeading(frame.heading[i]);
+            trajectory::putDelta(chunk, x, last[0]);
+            trajectory::putDelta(chunk, y, last[1]);
+            trajectory::putDelta(chunk, heading, last[2]);
+            last[0] = x;
+            last[1] = y;
+            last[2] = heading;
+        }
+        chunkHeader.frameCount++;
+    }
+
+    void TrajectoryRecorder::flushChunk()
+    {
+        if (chunkHeader.frameCount == 0)
+        {
+            return;
+        }
+        index.push_back({fileOffset, writtenFrames, chunkHeader.cycle});
+        chunkHeader.payloadSize = chunk.size();
+        file.write(reinterpret_cast<const char *>(&chunkHeader), sizeof(chunkHeader));
+        file.write(reinterpret_cast<const char *>(chunk.data()), chunk.size());
+        fileOffset += sizeof(chunkHeader) + chunk.size();
+        writtenFrames += chunkHeader.frameCount;
+        chunkHeader.frameCount = 0;
+    }
+
+    bool TrajectoryRecorder::close()
+    {
+        if (!isOpen())
+        {
+            return true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        changed.notify_all();
+        writer.join();
+
+        header.frameCount = writtenFrames;
+        header.chunkCount = index.size();
+        header.indexOffset = fileOffset;
+        file.write(reinterpret_cast<const char *>(index.data()), index.size() * sizeof(trajectory::Index));
+        file.seekp(0);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.close();
+        if (failed || file.fail())
+        {
+            std::cerr << "[ERROR] Could not write trajectory file " << name << std::endl;
+            return false;
+        }
+        std::clog << "[INFO] Recorded " << writtenFrames << " frames in " << index.size() << " chunks to " << name << " ("
+                  << (fileOffset + index.size() * sizeof(trajectory::Index)) / (1024.0 * 1024.0) << " MiB, "
+                  << stalls << " stalls)" << std::endl;
+        return true;
+    }
+
+    TrajectoryReader::~TrajectoryReader()
+    {
+        close();
+    }
+
+    bool TrajectoryReader::open(const std::string &fileName)
+    {
+        using namespace trajectory;
+        close();
+
+        // seeking jumps between chunks, read-ahead would mostly fetch pages that are not needed
+        if (!view.open(fileName, util::FileView::Random) || view.size() < sizeof(Header))
+        {
+            std::cerr << "[ERROR] Could not open trajectory file " << fileName << std::endl;
+            view.close();
+            return false;
+        }
+        file = view.bytes();
+        fileSize = view.size();
+
+        std::memcpy(&header, file, sizeof(header));
+        size_t chunksBegin = sizeof(Header) + size_t(header.targetCount) * sizeof(Target);
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version || chunksBegin > fileSize)
+        {
+            std::cerr << "[ERROR] " << fileName << " is not a trajectory file of version " << version << std::endl;
+            close();
+            return false;
+        }
+        targetList.resize(header.targetCount);
+        std::memcpy(targetList.data(), file + sizeof(Header), targetList.size() * sizeof(Target));
+
+        bool hasIndex = header.indexOffset >= chunksBegin && header.indexOffset <= fileSize &&
+                        header.chunkCount <= (fileSize - header.indexOffset) / sizeof(Index);
+        if (hasIndex)
+        {
+            index.resize(header.chunkCount);
+            if (!index.empty())
+            {
+                std::memcpy(index.data(), file + header.indexOffset, index.size() * sizeof(Index));
+            }
+            frames = header.frameCount;
+            // seek() relies on the first chunk starting at frame 0
+            hasIndex = !index.empty() && index[0].firstFrame == 0;
+            for (size_t i = 0; i < index.size() && hasIndex; i++)
+            {
+                hasIndex = index[i].offset >= chunksBegin && index[i].offset + sizeof(ChunkHeader) <= header.indexOffset &&
+                           index[i].firstFrame < frames && (i == 0 || index[i].firstFrame > index[i - 1].firstFrame);
+            }
+        }
+        if (!hasIndex)
+        {
+            // the recording was not closed: walk the chunks, a truncated last chunk is dropped
+            size_t offset = chunksBegin;
+            size_t end = header.indexOffset >= chunksBegin && header.indexOffset < fileSize ? header.indexOffset : fileSize;
+            index.clear();
+            frames = 0;
+            while (offset + sizeof(ChunkHeader) <= end)
+            {
+                ChunkHeader chunk;
+                std::memcpy(&chunk, file + offset, sizeof(chunk));
+                if (chunk.payloadSize > end - offset - sizeof(ChunkHeader) || chunk.frameCount == 0 || chunk.agentCount > header.agents)
+                {
+                    break;
+                }
+                index.push_back({offset, frames, chunk.cycle});
+                frames += chunk.frameCount;
+                offset += sizeof(ChunkHeader) + chunk.payloadSize;
+            }
+            std::cout << "[INFO] " << fileName << " has no index, found " << index.size() << " chunks" << std::endl;
+        }
+        return seek(0) || frames == 0;
+    }
+
+    void TrajectoryReader::close()
+    {
+        view.close();
+        file = nullptr;
+        fileSize = 0;
+        index.clear();
+        frames = 0;
+        nextFrame = 0;
+        framesLeft = 0;
+    }
+
+    void TrajectoryReader::startChunk(size_t chunkIndex)
+    {
+        chunk = chunkIndex;
+        size_t offset = index[chunk].offset;
+        std::memcpy(&chunkHeader, file + offset, sizeof(chunkHeader));
+        cursor = file + offset + sizeof(chunkHeader);
+        chunkEnd = cursor + std::min<uint64_t>(chunkHeader.payloadSize, fileSize - (offset + sizeof(chunkHeader)));
+        if (chunkHeader.agentCount > header.agents)
+        {
+            // damaged, skipped by next()
+            chunkHeader.agentCount = 0;
+            chunkHeader.frameCount = 0;
+        }
+        size_t colorBytes = size_t(chunkHeader.agentCount) * sizeof(uint32_t);
+        colors.resize(chunkHeader.agentCount);
+        if (colorBytes <= size_t(chunkEnd - cursor))
+        {
+            if (colorBytes > 0)
+            {
+                std::memcpy(colors.data(), cursor, colorBytes);
+            }
+            cursor += colorBytes;
+        }
+        else
+        {
+            cursor = chunkEnd; // damaged, decodeFrame() fails
+        }
+        previous.assign(size_t(chunkHeader.agentCount) * 3, 0);
+        framesLeft = chunkHeader.frameCount;
+        nextFrame = index[chunk].firstFrame;
+    }
+
+    bool TrajectoryReader::seek(uint64_t frame)
+    {
+        if (frame >= frames)
+        {
+            return false;
+        }
+        auto found = std::upper_bound(index.begin(), index.end(), frame,
+                                      [](uint64_t value, const trajectory::Index &entry) { return value < entry.firstFrame; });
+        if (found == index.begin())
+        {
+            return false;
+        }
+        startChunk(size_t(found - index.begin()) - 1);
+
+        // frames are stored as differences, so the frames before `frame` in its chunk are decoded
+        TrajectoryFrame skipped;
+        while (nextFrame < frame)
+        {
+            if (!decodeFrame(skipped))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool TrajectoryReader::next(TrajectoryFrame &frame)
+    {
+        while (framesLeft == 0)
+        {
+            if (chunk + 1 >= index.size())
+            {
+                return false;
+            }
+            startChunk(chunk + 1);
+        }
+        return decodeFrame(frame);
+    }
+
+    bool TrajectoryReader::decodeFrame(TrajectoryFrame &frame)
+    {
+        uint32_t step;
+        if (framesLeft == 0 || !trajectory::getVarint(cursor, chunkEnd, step))
+        {
+            return false;
+        }
+        size_t agents = chunkHeader.agentCount;
+        frame.cycle = chunkHeader.cycle;
+        frame.step = static_cast<int>(step);
+        frame.x.resize(agents);
+        frame.y.resize(agents);
+        frame.heading.resize(agents);
+        frame.color = colors;
+        uint16_t *last = previous.data();
+        for (size_t i = 0; i < agents; i++, last += 3)
+        {
+            if (!trajectory::getDelta(cursor, chunkEnd, last[0]) || !trajectory::getDelta(cursor, chunkEnd, last[1]) ||
+                !trajectory::getDelta(cursor, chunkEnd, last[2]))
+            {
+                framesLeft = 0;
+                return false;
+            }
+            frame.x[i] = trajectory::dequantizePosition(last[0], header.worldSize);
+            frame.y[i] = trajectory::dequantizePosition(last[1], header.worldSize);
+            frame.heading[i] = trajectory::dequantizeHeading(last[2]);
+        }
+        framesLeft--;
+        nextFrame++;
+        return true;
+    }
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "config.h"
+#include "util/fileview.h"
+
+namespace sim
+{
+    class Simulation;
+
+    // Agent positions and headings after one step
+    struct TrajectoryFrame
+    {
+        uint64_t cycle = 0;
+        int step = 0;
+        std::vector<float> x, y, heading;
+        std::vector<uint32_t> color; // RGBA8, constant within a cycle
+    };
+
+    // Append-only trajectory file, see TrajectoryRecorder.
+    //
+    //   [ Header | Target x targetCount | Chunk ... | Index x chunkCount ]
+    //
+    // A chunk holds up to `framesPerChunk` consecutive frames of one cycle: a ChunkHeader, the
+    // colors of all agents and then per frame the step (varint) followed by x, y and heading
+    // of every agent. Values are quantized to 16 bit (positions relative to the world, headings
+    // as a fraction of a turn) and stored as the zigzag varint of the difference to the
+    // previous frame of the chunk; the first frame of a chunk is stored against zero, so every
+    // chunk decodes on its own. The index at the end is written when the recording is closed;
+    // without it (e.g. after a crash) readers find the chunks by walking the chunk headers.
+    namespace trajectory
+    {
+        const char magic[8] = {'A', 'I', 'A', 'G', 'E', 'N', 'T', 'T'};
+        const uint32_t version = 1;
+
+        struct Header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t framesPerChunk;
+            uint64_t agents;
+            float worldSize;
+            float agentRadius;
+            uint32_t targetCount;
+            uint32_t reserved;
+            uint64_t frameCount;  // 0 until the recording is closed
+            uint64_t chunkCount;  // 0 until the recording is closed
+            uint64_t indexOffset; // 0 until the recording is closed
+        };
+
+        struct ChunkHeader
+        {
+            uint64_t cycle;
+            uint32_t frameCount;
+            uint32_t agentCount;
+            uint64_t payloadSize; // bytes following this header
+        };
+
+        struct Index
+        {
+            uint64_t offset; // of the ChunkHeader
+            uint64_t firstFrame;
+            uint64_t cycle;
+        };
+
+        static_assert(std::is_trivially_copyable<Header>::value && sizeof(Header) == 64, "trajectory header layout changed");
+        static_assert(sizeof(ChunkHeader) == 24 && sizeof(Index) == 24, "trajectory chunk layout changed");
+    }
+
+    // Streams the agent state of every recorded step into a trajectory file.
+    //
+    // record() only copies the agent arrays into a pooled frame; quantization, delta encoding
+    // and writing happen on a background thread, so recording costs the simulation little more
+    // than a memcpy. If the writer falls behind, record() waits for a free frame instead of
+    // dropping one.
+    class TrajectoryRecorder
+    {
+    public:
+        ~TrajectoryRecorder();
+
+        bool open(const std::string &fileName, const Config &config, size_t framesPerChunk = 64);
+        // appends the current state of `simulation`
+        void record(const Simulation &simulation);
+        // flushes all frames and writes the index
+        bool close();
+
+        bool isOpen() const { return writer.joinable(); }
+        uint64_t recordedFrames() const { return frames; }
+        // calls to record() that had to wait for the writer
+        uint64_t stallCount() const { return stalls; }
+
+    private:
+        void writeLoop();
+        void encode(const TrajectoryFrame &frame);
+        void flushChunk();
+
+        std::ofstream file;
+        std::string name;
+        trajectory::Header header = {};
+        std::thread writer;
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<TrajectoryFrame> pool;
+        std::vector<TrajectoryFrame *> freeFrames;
+        std::deque<TrajectoryFrame *> pending;
+        bool closing = false;
+        bool failed = false;
+        uint64_t frames = 0;
+        uint64_t stalls = 0;
+
+        // writer thread
+        std::vector<trajectory::Index> index;
+        std::vector<uint8_t> chunk; // payload of the current chunk
+        std::vector<uint16_t> previous; // quantized x, y, heading of the previous frame
+        trajectory::ChunkHeader chunkHeader = {};
+        uint64_t writtenFrames = 0;
+        uint64_t fileOffset = 0;
+    };
+
+    // Reads trajectory files written by TrajectoryRecorder.
+    class TrajectoryReader
+    {
+    public:
+        ~TrajectoryReader();
+
+        bool open(const std::string &fileName);
+        void close();
+
+        uint64_t frameCount() const { return frames; }
+        uint64_t agents() const { return header.agents; }
+        float worldSize() const { return header.worldSize; }
+        float agentRadius() const { return header.agentRadius; }
+        const std::vector<Target> &targets() const { return targetList; }
+
+        // the next call to next() returns frame `frame`
+        bool seek(uint64_t frame);
+        // decodes the next frame, returns false at the end of the recording
+        bool next(TrajectoryFrame &frame);
+        uint64_t position() const { return nextFrame; }
+
+    private:
+        void startChunk(size_t chunkIndex);
+        bool decodeFrame(TrajectoryFrame &frame);
+
+        util::FileView view;
+        const uint8_t *file = nullptr;
+        size_t fileSize = 0;
+        trajectory::Header header = {};
+        std::vector<Target> targetList;
+        std::vector<trajectory::Index> index;
+        uint64_t frames = 0;
+
+        // decoder state
+        size_t chunk = 0;
+        trajectory::ChunkHeader chunkHeader = {};
+        const uint8_t *cursor = nullptr, *chunkEnd = nullptr;
+        uint32_t framesLeft = 0; // in the current chunk
+        std::vector<uint32_t> colors;
+        std::vector<uint16_t> previous;
+        uint64_t nextFrame = 0;
+    };
+}
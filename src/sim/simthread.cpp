@@ -0,0 +1,172 @@
+#include "simthread.h"
+
+#include <chrono>
+#include <iostream>
+
+#include "timestep.h"
+
+namespace sim
+{
+    // one simulation step per 1/60s at 1x speed
+    const double stepSeconds = 1.0 / 60.0;
+    // snapshots are published at most this often while fast forwarding
+    const double publishInterval_s = 0.004;
+
+    SimulationThread::SimulationThread(const Config &config) : simulation(config)
+    {
+    }
+
+    SimulationThread::~SimulationThread()
+    {
+        stop();
+    }
+
+    double SimulationThread::now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool SimulationThread::record(const std::string &fileName)
+    {
+        return recorder.open(fileName, simulation.config());
+    }
+
+    bool SimulationThread::start()
+    {
+        if (!simulation.reset())
+        {
+            return false;
+        }
+        steps = 0;
+        recorder.record(simulation);
+        publish();
+
+        running = true;
+        thread = std::thread(&SimulationThread::run, this);
+        std::cout << "[INFO] Simulation thread started" << std::endl;
+        return true;
+    }
+
+    bool SimulationThread::startReplay(const std::string &fileName)
+    {
+        if (!reader.open(fileName) || !reader.next(frame))
+        {
+            std::cerr << "[ERROR] Nothing to replay in " << fileName << std::endl;
+            return false;
+        }
+        replaying = true;
+        steps = 0;
+        replayFrame = reader.position() - 1;
+        publish();
+
+        running = true;
+        thread = std::thread(&SimulationThread::run, this);
+        std::cout << "[INFO] Replaying " << reader.frameCount() << " frames from " << fileName << std::endl;
+        return true;
+    }
+
+    void SimulationThread::stop()
+    {
+        running = false;
+        if (thread.joinable())
+        {
+            thread.join();
+            std::cout << "[INFO] Simulation thread stopped" << std::endl;
+        }
+        recorder.close();
+    }
+
+    // one simulation step, or the next frame of the replay
+    void SimulationThread::advance()
+    {
+        steps++;
+        if (replaying)
+        {
+            uint64_t target = seekRequest.exchange(noSeek);
+            if ((target != noSeek && !reader.seek(target)) || !reader.next(frame))
+            {
+                // start over at the end
+                reader.seek(0);
+                reader.next(frame);
+            }
+            replayFrame = reader.position() - 1;
+            return;
+        }
+
+        simulation.step();
+        if (simulation.cycleComplete())
+        {
+            recorder.record(simulation);
+            simulation.endCycle();
+        }
+        recorder.record(simulation);
+    }
+
+    void SimulationThread::publish()
+    {
+        Snapshot &snapshot = snapshots.back();
+        if (replaying)
+        {
+            snapshot.cycle = frame.cycle;
+            snapshot.stepInCycle = frame.step;
+            snapshot.agents.resize(frame.x.size());
+            for (size_t i = 0; i < frame.x.size(); i++)
+            {
+                snapshot.agents[i] = {frame.x[i], frame.y[i], frame.heading[i], frame.color[i]};
+            }
+        }
+        else
+        {
+            const AgentStore &agents = simulation.agents();
+            snapshot.cycle = simulation.cycle();
+            snapshot.stepInCycle = simulation.stepInCycle();
+            snapshot.agents.resize(agents.size());
+            for (size_t i = 0; i < agents.size(); i++)
+            {
+                snapshot.agents[i] = {agents.x[i], agents.y[i], agents.heading[i], agents.color[i]};
+            }
+        }
+        snapshot.steps = steps;
+        snapshot.time = now();
+
+        snapshots.publish();
+    }
+
+    void SimulationThread::run()
+    {
+        FixedTimestep timestep(stepSeconds);
+        double lastTime = now();
+        double lastPublish = lastTime;
+
+        while (running)
+        {
+            timestep.setSpeed(speed.load());
+            double currentTime = now();
+            uint64_t dueSteps = timestep.advance(currentTime - lastTime);
+            lastTime = currentTime;
+
+            for (uint64_t i = 0; i < dueSteps && running; i++)
+            {
+                advance();
+
+                // while fast forwarding only every few milliseconds a snapshot is published
+                double time = now();
+                if (time - lastPublish >= publishInterval_s || i + 1 == dueSteps)
+                {
+                    publish();
+                    lastPublish = time;
+                    if (timestep.isUnlimited())
+                    {
+                        break;
+                    }
+                }
+            }
+
+            // caught up, wait for the next step to become due
+            if (!timestep.isUnlimited() && running)
+            {
+                std::this_thread::sleep_for(std::chrono::duration<double>(timestep.secondsToNextStep()));
+            }
+        }
+    }
+}
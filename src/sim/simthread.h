@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config.h"
+#include "recorder.h"
+#include "simulation.h"
+#include "triplebuffer.h"
+
+namespace sim
+{
+    // State of one agent as needed by the renderer
+    struct AgentState
+    {
+        float x, y;
+        float heading;
+        uint32_t color; // RGBA8
+    };
+
+    struct Snapshot
+    {
+        uint64_t cycle = 0;
+        int stepInCycle = 0;
+        uint64_t steps = 0; // total number of steps since start
+        double time = 0.0;  // steady clock seconds at publication
+        std::vector<AgentState> agents;
+    };
+
+    // Runs a Simulation on its own thread with a fixed timestep (see FixedTimestep) and publishes
+    // snapshots of the agent state through a lock-free triple buffer, so neither the renderer nor
+    // the simulation ever blocks the other.
+    // Instead of simulating, the thread can also play a trajectory recording at the same pace.
+    class SimulationThread
+    {
+    public:
+        explicit SimulationThread(const Config &config);
+        ~SimulationThread();
+
+        bool start();
+        void stop();
+
+        // call before start(): every simulation step is appended to a trajectory file
+        bool record(const std::string &fileName);
+        // call instead of start(): plays a recording in a loop
+        bool startReplay(const std::string &fileName);
+        bool isReplaying() const { return replaying; }
+        const TrajectoryReader &replay() const { return reader; }
+        // frame of the recording that is shown; seek() takes effect on the simulation thread
+        uint64_t replayPosition() const { return replayFrame.load(); }
+        void seek(uint64_t frame) { seekRequest.store(frame); }
+
+        // see FixedTimestep::setSpeed()
+        void setSpeed(double multiplier) { speed.store(multiplier); }
+
+        // render side: fetch the newest snapshot, returns false if there is nothing new
+        bool fetch() { return snapshots.fetch(); }
+        const Snapshot &latest() const { return snapshots.front(); }
+
+        static double now();
+
+    private:
+        void run();
+        void advance();
+        void publish();
+
+        Simulation simulation;
+        TrajectoryRecorder recorder;
+        TrajectoryReader reader;
+        TrajectoryFrame frame; // current frame of the replay
+        bool replaying = false;
+        std::atomic<uint64_t> replayFrame{0};
+        std::atomic<uint64_t> seekRequest{noSeek};
+        static const uint64_t noSeek = UINT64_MAX;
+        TripleBuffer<Snapshot> snapshots;
+        std::thread thread;
+        std::atomic<bool> running{false};
+        std::atomic<double> speed{1.0};
+        uint64_t steps = 0;
+    };
+}
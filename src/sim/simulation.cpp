@@ -0,0 +1,516 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace sim
+{
+    const float pi = 3.14159265358979f;
+
+    // items per parallelFor() chunk; large enough to amortize claiming a chunk
+    const size_t agentsPerJob = 1024;
+    const size_t batchesPerJob = 16;
+
+    Simulation::Simulation(const Config &config) : simConfig(config)
+    {
+    }
+
+    bool Simulation::reset()
+    {
+        if (!configure(simConfig))
+        {
+            return false;
+        }
+
+        CounterRng genomeRng(simConfig.seed, RandomStream::Genome, cycleIndex);
+        population.add(simConfig.population);
+        for (size_t i = 0; i < simConfig.population; i++)
+        {
+            genome::randomize(population.genome(i), simConfig.genomeLength, genomeRng, uint32_t(i));
+            population.color[i] = genome::color(population.genome(i), simConfig.genomeLength);
+            population.lineage[i] = static_cast<uint32_t>(i);
+        }
+        if (!placeRandomly())
+        {
+            return false;
+        }
+        buildNetworks();
+        return true;
+    }
+
+    bool Simulation::configure(const Config &config)
+    {
+        if (config.hiddenNeurons < 1 || config.hiddenNeurons > 128)
+        {
+            std::cerr << "[ERROR] Number of hidden neurons must be 1..128 (" << config.hiddenNeurons << ")" << std::endl;
+            return false;
+        }
+        simConfig = config;
+
+        cycleIndex = 0;
+        stepIndex = 0;
+
+        jobs.start(simConfig.threads);
+        scratch.resize(jobs.workerCount());
+        // which worker gets which chunk changes from run to run, so every worker is ready for any of them
+        for (WorkerScratch &worker : scratch)
+        {
+            worker.values.reserve(size_t(network::valueCount(simConfig.hiddenNeurons)) * NetworkBatches::maxLanes);
+            worker.random.reserve(agentsPerJob);
+        }
+        grid.configure(simConfig.worldSize, simConfig.gridUnit());
+        density.configure(simConfig.worldSize, simConfig.gridUnit());
+        occupancy.configure(simConfig.worldSize, simConfig.gridUnit());
+        field.bake(simConfig);
+        // the initial genomes are the current generation, offspring are built in the other arena
+        generations.reset();
+        population.reset(simConfig.genomeLength, simConfig.hiddenNeurons);
+        population.bindGenomes(&generations.current());
+        population.reserve(simConfig.population);
+        offspring.reset(simConfig.genomeLength, simConfig.hiddenNeurons);
+        offspring.bindGenomes(&generations.next());
+        offspring.reserve(simConfig.population);
+        return true;
+    }
+
+    // the networks live as long as the genomes they are compiled from
+    void Simulation::buildNetworks()
+    {
+        Arena &arena = generations.current();
+        connections.bind(&arena);
+        networks.bind(&arena);
+        batches.bind(&arena);
+        connections.genomeLength = simConfig.genomeLength;
+        genome::decodeBatch(population.genes.data(), population.size(), simConfig.hiddenNeurons, connections);
+        network::compileAll(connections, simConfig.hiddenNeurons, networks);
+        network::buildBatches(networks, batches);
+    }
+
+    // Rule 1: agents are placed randomly at the beginning of a cycle. Every agent gets the center
+    // of a distinct grid cell, so no two agents overlap.
+    bool Simulation::placeRandomly()
+    {
+        float unit = simConfig.gridUnit();
+        int cellsPerSide = static_cast<int>(simConfig.worldSize / unit);
+        size_t freeCells = size_t(cellsPerSide) * size_t(cellsPerSide);
+        if (population.size() > freeCells)
+        {
+            std::cerr << "[ERROR] World is too small for " << population.size() << " agents ("
+                      << freeCells << " cells)" << std::endl;
+            return false;
+        }
+
+        // partial Fisher-Yates shuffle of the cell indices
+        cellOrder.resize(freeCells);
+        for (size_t i = 0; i < freeCells; i++)
+        {
+            cellOrder[i] = static_cast<uint32_t>(i);
+        }
+
+        // the random numbers are drawn in parallel, only the shuffle itself is sequential
+        CounterRng placementRng(simConfig.seed, RandomStream::Placement, cycleIndex);
+        placementRandom.resize(population.size());
+        jobs.parallelFor(population.size(), agentsPerJob, [&](size_t begin, size_t end, unsigned) {
+            placementRng.blockBatch(uint32_t(begin), end - begin, &placementRandom[begin]);
+        });
+
+        float origin = -0.5f * cellsPerSide * unit;
+        for (size_t i = 0; i < population.size(); i++)
+        {
+            const CounterRng::Block &random = placementRandom[i];
+            size_t pick = i + CounterRng::toRange(random.word[0], uint32_t(freeCells - i));
+            std::swap(cellOrder[i], cellOrder[pick]);
+
+            population.x[i] = origin + (cellOrder[i] % cellsPerSide + 0.5f) * unit;
+            population.y[i] = origin + (cellOrder[i] / cellsPerSide + 0.5f) * unit;
+            population.velocity[i] = 0.0f;
+            population.heading[i] = CounterRng::toUniform(random.word[1]) * (2.0f * pi) - pi;
+            population.energy[i] = 1.0f;
+        }
+        std::fill(population.hidden.begin(), population.hidden.end(), 0.0f);
+
+        // Agents are stored in the order of their cells (row by row), so agents that are close in the
+        // world are close in memory and the neighbour queries of a step read the agent arrays almost
+        // sequentially. Agents move only a few cells per cycle, so sorting once per cycle keeps most
+        // of the locality. Which agent got which cell is decided above, so the placement stays random.
+        const uint32_t noAgent = ~0u;
+        cellAgent.assign(freeCells, noAgent);
+        for (size_t i = 0; i < population.size(); i++)
+        {
+            cellAgent[cellOrder[i]] = static_cast<uint32_t>(i);
+        }
+        agentOrder.clear();
+        for (uint32_t agent : cellAgent)
+        {
+            if (agent != noAgent)
+            {
+                agentOrder.push_back(agent);
+            }
+        }
+        population.reorder(agentOrder.data());
+        density.build(population.x.data(), population.y.data(), population.size());
+        return true;
+    }
+
+    bool Simulation::isInTarget(float x, float y) const
+    {
+        for (const Target &target : simConfig.targets)
+        {
+            float dx = x - target.x, dy = y - target.y;
+            if (dx * dx + dy * dy <= target.radius * target.radius)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Simulation::sense(size_t index, float *inputs)
+    {
+        float agentX = population.x[index], agentY = population.y[index];
+        float hx = headingX[index], hy = headingY[index];
+
+        float gx, gy;
+        inputs[TDe] = std::min(field.sample(agentX, agentY, &gx, &gy), 1.0f);
+        inputs[TGH] = std::clamp((gx * hx + gy * hy) * simConfig.targetFieldFalloff, -1.0f, 1.0f);
+        inputs[TGL] = std::clamp((gy * hx - gx * hy) * simConfig.targetFieldFalloff, -1.0f, 1.0f);
+
+        inputs[Vel] = population.velocity[index] / simConfig.maxSpeed;
+        inputs[Hdg] = population.heading[index] / pi;
+        inputs[Age] = float(stepIndex) / simConfig.stepsPerCycle;
+        inputs[Rnd] = randomInputs[index];
+        inputs[Nrg] = population.energy[index];
+
+        // population density and its gradient over the NxN cells around the agent; the gradient is
+        // the difference between the cells on either side of the agent's row and column
+        int half = simConfig.sensorGridSize / 2;
+        int ownX = density.cellX(agentX), ownY = density.cellY(agentY);
+        int x0 = ownX - half, x1 = ownX + half, y0 = ownY - half, y1 = ownY + half;
+        int count = density.windowSum(x0, y0, x1, y1) - 1; // the agent itself
+        int gradientX = density.windowSum(ownX + 1, y0, x1, y1) - density.windowSum(x0, y0, ownX - 1, y1);
+        int gradientY = density.windowSum(x0, ownY + 1, x1, y1) - density.windowSum(x0, y0, x1, ownY - 1);
+        float window = float((2 * half + 1) * (2 * half + 1));
+        float popGradientX = gradientX / window, popGradientY = gradientY / window;
+        inputs[Pop] = count / window;
+        inputs[PGH] = popGradientX * hx + popGradientY * hy;
+        inputs[PGL] = popGradientY * hx - popGradientX * hy;
+
+        inputs[Osc] = std::sin(2.0f * pi * stepIndex / simConfig.oscillatorPeriod);
+        // Blk and BLt are cast for all agents at once, see step()
+    }
+
+    // Rule 6: agents can not move into or over each other. A move is blocked by the position of any
+    // other agent at the start of the step and by the target of every moving agent with a lower
+    // index. Neither depends on the outcome of other moves, so all agents are resolved in parallel
+    // and the result does not depend on the number of threads.
+    void Simulation::resolveCollisions()
+    {
+        // the grid holds the positions from the start of the step, targets are at most maxSpeed away
+        float minDistance = 2.0f * simConfig.agentRadius;
+        float minDistance2 = minDistance * minDistance;
+        float reach = minDistance + simConfig.maxSpeed;
+        size_t count = population.size();
+        blocked.resize(count);
+
+        jobs.parallelFor(count, agentsPerJob, [&](size_t begin, size_t end, unsigned) {
+            for (size_t index = begin; index < end; index++)
+            {
+                blocked[index] = 0;
+                if (population.velocity[index] <= 0.0f)
+                {
+                    continue;
+                }
+                float x = targetX[index], y = targetY[index];
+                bool collides = false;
+                grid.forEachNear(x, y, reach, [&](uint32_t i) {
+                    if (i == index)
+                    {
+                        return;
+                    }
+                    float dx = population.x[i] - x, dy = population.y[i] - y;
+                    collides |= dx * dx + dy * dy < minDistance2;
+                    if (i < index && population.velocity[i] > 0.0f)
+                    {
+                        dx = targetX[i] - x;
+                        dy = targetY[i] - y;
+                        collides |= dx * dx + dy * dy < minDistance2;
+                    }
+                });
+                blocked[index] = collides;
+            }
+        });
+
+        jobs.parallelFor(count, agentsPerJob, [&](size_t begin, size_t end, unsigned) {
+            for (size_t index = begin; index < end; index++)
+            {
+                if (population.velocity[index] <= 0.0f)
+                {
+                    continue;
+                }
+                if (blocked[index])
+                {
+                    population.velocity[index] = 0.0f;
+                    continue;
+                }
+                density.move(population.x[index], population.y[index], targetX[index], targetY[index]);
+                population.x[index] = targetX[index];
+                population.y[index] = targetY[index];
+            }
+        });
+    }
+
+    void Simulation::evaluateNetworks()
+    {
+        int hiddenCount = simConfig.hiddenNeurons;
+        int valueCount = network::valueCount(hiddenCount);
+
+        // agents with the same topology, one per SIMD lane
+        int lanes = batches.lanes;
+        jobs.parallelFor(batches.batches.size(), batchesPerJob, [&](size_t begin, size_t end, unsigned worker) {
+            std::vector<float> &values = scratch[worker].values;
+            values.resize(size_t(valueCount) * lanes);
+            for (size_t b = begin; b < end; b++)
+            {
+                const NetworkBatches::Batch &batch = batches.batches[b];
+                std::fill(values.begin(), values.end(), 0.0f);
+                for (uint32_t lane = 0; lane < batch.memberCount; lane++)
+                {
+                    uint32_t agent = batches.members[batch.firstMember + lane];
+                    const float *inputs = &sensors[size_t(agent) * InputCount];
+                    const float *hidden = population.hiddenState(agent);
+                    for (int v = 0; v < InputCount; v++)
+                    {
+                        values[v * lanes + lane] = inputs[v];
+                    }
+                    for (int h = 0; h < hiddenCount; h++)
+                    {
+                        values[network::previousHidden(h) * lanes + lane] = hidden[h];
+                    }
+                }
+
+                network::evaluateBatch(networks, batches, b, values.data());
+
+                for (uint32_t lane = 0; lane < batch.memberCount; lane++)
+                {
+                    uint32_t agent = batches.members[batch.firstMember + lane];
+                    float *hidden = population.hiddenState(agent);
+                    for (int h = 0; h < hiddenCount; h++)
+                    {
+                        hidden[h] = values[network::currentHidden(h, hiddenCount) * lanes + lane];
+                    }
+                    for (int o = 0; o < OutputCount; o++)
+                    {
+                        actions[size_t(agent) * OutputCount + o] = values[network::output(o, hiddenCount) * lanes + lane];
+                    }
+                }
+            }
+        });
+
+        // unique topologies
+        jobs.parallelFor(batches.singles.size(), agentsPerJob, [&](size_t begin, size_t end, unsigned worker) {
+            std::vector<float> &values = scratch[worker].values;
+            values.resize(valueCount);
+            for (size_t s = begin; s < end; s++)
+            {
+                uint32_t agent = batches.singles[s];
+                float *hidden = population.hiddenState(agent);
+                std::copy_n(&sensors[size_t(agent) * InputCount], InputCount, values.begin());
+                std::copy_n(hidden, hiddenCount, values.begin() + network::previousHidden(0));
+                // pruned hidden neurons are not written by the program
+                std::fill_n(values.begin() + network::currentHidden(0, hiddenCount), hiddenCount, 0.0f);
+
+                network::evaluate(networks, agent, values.data());
+
+                std::copy_n(values.begin() + network::currentHidden(0, hiddenCount), hiddenCount, hidden);
+                std::copy_n(values.begin() + network::output(0, hiddenCount), OutputCount, actions.begin() + size_t(agent) * OutputCount);
+            }
+        });
+    }
+
+    void Simulation::step()
+    {
+        size_t count = population.size();
+        const float *x = population.x.data(), *y = population.y.data();
+        grid.build(x, y, count);
+        density.buildSummedArea();
+        occupancy.build(x, y, count);
+
+        // sense first, so networks of different agents can be evaluated together
+        headingX.resize(count);
+        headingY.resize(count);
+        sensors.resize(count * InputCount);
+        actions.resize(count * OutputCount);
+        rays.resize(count);
+        randomInputs.resize(count);
+        CounterRng sensorRng(simConfig.seed, RandomStream::Sensor, cycleIndex, uint32_t(stepIndex));
+        jobs.parallelFor(count, agentsPerJob, [&](size_t begin, size_t end, unsigned) {
+            sensorRng.uniformBatch(uint32_t(begin), end - begin, &randomInputs[begin]);
+            for (size_t i = begin; i < end; i++)
+            {
+                headingX[i] = std::cos(population.heading[i]);
+                headingY[i] = std::sin(population.heading[i]);
+                sense(i, &sensors[i * InputCount]);
+            }
+
+            // blockage ahead, and to the left minus to the right
+            int range = simConfig.sensorGridSize;
+            size_t n = end - begin;
+            const float *hx = &headingX[begin], *hy = &headingY[begin];
+            occupancy.castRays(x + begin, y + begin, hx, hy, n, OccupancyGrid::Ahead, range, &sensors[begin * InputCount + Blk], InputCount);
+            occupancy.castRays(x + begin, y + begin, hx, hy, n, OccupancyGrid::Left, range, &sensors[begin * InputCount + BLt], InputCount);
+            occupancy.castRays(x + begin, y + begin, hx, hy, n, OccupancyGrid::Right, range, &rays[begin], 1);
+            for (size_t i = begin; i < end; i++)
+            {
+                sensors[i * InputCount + BLt] -= rays[i];
+            }
+        });
+
+        evaluateNetworks();
+
+        // Rules 4-5 for all agents at once, then the moves that are not blocked
+        targetX.resize(count);
+        targetY.resize(count);
+        jobs.parallelFor(count, agentsPerJob, [&](size_t begin, size_t end, unsigned) {
+            movement::integrate(simConfig, population, actions.data(), targetX.data(), targetY.data(), begin, end);
+        });
+        resolveCollisions();
+
+        stepIndex++;
+    }
+
+    // Rule 2: agents inside a target area reproduce before they die. Survivors share the
+    // offspring evenly; every offspring has a chance of a single bit flip in its genome.
+    //
+    // All passes run in parallel over fixed chunks of agents: survivors are flagged and counted per
+    // chunk, a prefix sum over the chunk counts gives every chunk the place of its survivors in the
+    // survivor list, and a prefix sum over the offspring counts gives every survivor the range of
+    // its children, whose genomes are then copied and mutated straight into the new store.
+    CycleStats Simulation::endCycle()
+    {
+        auto start = std::chrono::steady_clock::now();
+        CycleStats stats = {};
+        stats.cycle = cycleIndex;
+        stats.population = population.size();
+
+        size_t count = population.size();
+        size_t chunks = (count + agentsPerJob - 1) / agentsPerJob;
+        hashes.resize(count);
+        survives.resize(count);
+        chunkSurvivors.assign(chunks, 0);
+        chunkEnergy.assign(chunks, 0.0f);
+        jobs.parallelFor(count, agentsPerJob, [&](size_t begin, size_t end, unsigned) {
+            uint32_t survivors = 0;
+            float energy = 0.0f;
+            for (size_t i = begin; i < end; i++)
+            {
+                energy += population.energy[i];
+                hashes[i] = genome::hash(population.genome(i), simConfig.genomeLength);
+                survives[i] = isInTarget(population.x[i], population.y[i]);
+                survivors += survives[i];
+            }
+            chunkSurvivors[begin / agentsPerJob] = survivors;
+            chunkEnergy[begin / agentsPerJob] = energy;
+        });
+
+        // exclusive prefix sum, chunk sums are added in order so the result does not depend on the threads
+        uint32_t survivors = 0;
+        float energy = 0.0f;
+        for (size_t chunk = 0; chunk < chunks; chunk++)
+        {
+            uint32_t chunkCount = chunkSurvivors[chunk];
+            chunkSurvivors[chunk] = survivors;
+            survivors += chunkCount;
+            energy += chunkEnergy[chunk];
+        }
+        survivorIndex.resize(survivors);
+        jobs.parallelFor(count, agentsPerJob, [&](size_t begin, size_t end, unsigned) {
+            uint32_t next = chunkSurvivors[begin / agentsPerJob];
+            for (size_t i = begin; i < end; i++)
+            {
+                if (survives[i])
+                {
+                    survivorIndex[next++] = static_cast<uint32_t>(i);
+                }
+            }
+        });
+        stats.survivors = survivors;
+        stats.meanEnergy = population.empty() ? 0.0f : energy / population.size();
+        stats.meanConnections = population.empty() ? 0.0f : float(networks.source.size()) / population.size();
+        stats.groupingRatio = batches.groupingRatio();
+
+        // the arena of the previous generation is no longer referenced and takes the offspring
+        size_t children = simConfig.population;
+        offspring.clear();
+        offspring.bindGenomes(&generations.beginNext());
+        offspring.add(children);
+        if (survivors > 0)
+        {
+            // survivor s has the children firstChild[s]..firstChild[s + 1]-1
+            firstChild.resize(size_t(survivors) + 1);
+            firstChild[0] = 0;
+            for (size_t s = 0; s < survivors; s++)
+            {
+                firstChild[s + 1] = firstChild[s] + uint32_t(children / survivors + (s < children % survivors ? 1 : 0));
+            }
+
+            CounterRng mutationRng(simConfig.seed, RandomStream::Mutation, cycleIndex);
+            jobs.parallelFor(children, agentsPerJob, [&](size_t begin, size_t end, unsigned worker) {
+                std::vector<CounterRng::Block> &random = scratch[worker].random;
+                random.resize(end - begin);
+                mutationRng.blockBatch(uint32_t(begin), end - begin, random.data());
+
+                size_t s = std::upper_bound(firstChild.begin(), firstChild.end(), uint32_t(begin)) - firstChild.begin() - 1;
+                for (size_t child = begin; child < end; child++)
+                {
+                    while (firstChild[s + 1] <= child)
+                    {
+                        s++;
+                    }
+                    uint32_t parent = survivorIndex[s];
+                    const CounterRng::Block &block = random[child - begin];
+                    uint32_t flip = CounterRng::toUniform(block.word[0]) < simConfig.mutationRate
+                                        ? genome::mutationBit(block.word[1], simConfig.genomeLength)
+                                        : genome::noMutation;
+                    genome::inherit(population.genome(parent), offspring.genome(child), simConfig.genomeLength, flip);
+                    offspring.lineage[child] = population.lineage[parent];
+                }
+            });
+        }
+        else
+        {
+            // extinction: start over with random genomes
+            CounterRng genomeRng(simConfig.seed, RandomStream::Genome, cycleIndex + 1);
+            jobs.parallelFor(children, agentsPerJob, [&](size_t begin, size_t end, unsigned) {
+                for (size_t child = begin; child < end; child++)
+                {
+                    genome::randomize(offspring.genome(child), simConfig.genomeLength, genomeRng, uint32_t(child));
+                    offspring.lineage[child] = static_cast<uint32_t>(child);
+                }
+            });
+        }
+        jobs.parallelFor(children, agentsPerJob, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++)
+            {
+                offspring.color[i] = genome::color(offspring.genome(i), simConfig.genomeLength);
+                offspring.birthCycle[i] = cycleIndex + 1;
+            }
+        });
+        stats.reproductionSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::sort(hashes.begin(), hashes.end());
+        stats.uniqueGenomes = std::unique(hashes.begin(), hashes.end()) - hashes.begin();
+
+        cycleIndex++;
+        stepIndex = 0;
+        std::swap(population, offspring);
+        generations.advance();
+        // the agents are stored in cell order, so the networks are built after placing them
+        placeRandomly();
+        buildNetworks();
+        stats.arenaBytes = generations.current().used();
+        stats.arenaAllocations = generations.heapAllocations();
+        return stats;
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "agentstore.h"
+#include "arena.h"
+#include "config.h"
+#include "densitygrid.h"
+#include "genome.h"
+#include "jobsystem.h"
+#include "brain.h"
+#include "decoder.h"
+#include "network.h"
+#include "movement.h"
+#include "netbatch.h"
+#include "random.h"
+#include "occupancy.h"
+#include "spatialgrid.h"
+#include "targetfield.h"
+
+namespace sim
+{
+    struct CycleStats
+    {
+        uint64_t cycle;
+        size_t population;
+        size_t survivors;
+        size_t uniqueGenomes;
+        float meanConnections; // per compiled network, after pruning
+        float groupingRatio;   // fraction of networks evaluated in SIMD batches
+        float meanEnergy;
+        double reproductionSeconds; // survivor selection, offspring genomes and mutation
+        size_t arenaBytes;          // genomes and networks of the new generation
+        size_t arenaAllocations;    // heap blocks requested by the generation arenas so far
+    };
+
+    // CPU simulation of one world. Does not depend on GLFW or OpenGL.
+    //
+    // A cycle consists of `Config::stepsPerCycle` calls to step(); endCycle() then lets the agents
+    // inside a target area reproduce and starts the next cycle with their offspring.
+    class Simulation
+    {
+    public:
+        explicit Simulation(const Config &config);
+
+        // random genomes, random placement, cycle 0
+        bool reset();
+
+        // writes the complete state to `fileName`, replacing the file only once it is complete;
+        // the format is described in checkpoint.h
+        bool saveCheckpoint(const std::string &fileName) const;
+        // continues a saved simulation; its configuration replaces this one except for the thread count
+        bool loadCheckpoint(const std::string &fileName);
+
+        void step();
+        bool cycleComplete() const { return stepIndex >= simConfig.stepsPerCycle; }
+        CycleStats endCycle();
+
+        const Config &config() const { return simConfig; }
+        const AgentStore &agents() const { return population; }
+        uint64_t cycle() const { return cycleIndex; }
+        int stepInCycle() const { return stepIndex; }
+        unsigned threadCount() const { return jobs.workerCount(); }
+
+        bool isInTarget(float x, float y) const;
+        const TargetField &targetField() const { return field; }
+
+    private:
+        // validates `config`, takes it over and sets up an empty world at cycle 0; a rejected
+        // configuration leaves the simulation as it was
+        bool configure(const Config &config);
+        bool placeRandomly();
+        void buildNetworks();
+        void evaluateNetworks();
+        void sense(size_t index, float *inputs);
+        void resolveCollisions();
+
+        Config simConfig;
+        JobSystem jobs;
+
+        // per worker, so parallel phases need no allocations or locks
+        struct alignas(cacheLineSize) WorkerScratch
+        {
+            std::vector<float> values; // network values
+            std::vector<CounterRng::Block> random;
+        };
+        std::vector<WorkerScratch> scratch;
+
+        // genomes and everything compiled from them, one arena per generation
+        GenerationArena generations;
+        AgentStore population;
+        AgentStore offspring; // next generation, kept to reuse its memory
+        SpatialGrid grid; // agents per grid cell at the start of the step
+        DensityGrid density; // agents per grid cell, follows every move
+        OccupancyGrid occupancy; // occupied grid cells at the start of the step
+        TargetField field;
+
+        // decoded connections and compiled networks of all agents, rebuilt every cycle
+        ConnectionTable connections;
+        NetworkPrograms networks;
+        NetworkBatches batches;
+
+        std::vector<float> headingX, headingY; // unit heading vector per agent
+        std::vector<float> rays;               // scratch for the blockage sensors
+        AlignedVector<float> targetX, targetY; // where the agents move to unless blocked
+        std::vector<uint8_t> blocked;
+        std::vector<float> randomInputs;
+        std::vector<CounterRng::Block> placementRandom;
+        std::vector<uint32_t> cellOrder; // grid cells in placement order
+        std::vector<uint32_t> cellAgent; // agent placed in a grid cell, noAgent if empty
+        std::vector<uint32_t> agentOrder; // agents by cell, see placeRandomly()
+
+        // end of cycle
+        std::vector<uint8_t> survives;
+        std::vector<uint32_t> chunkSurvivors; // per chunk of agents, then their first index in survivorIndex
+        std::vector<float> chunkEnergy;
+        std::vector<uint32_t> survivorIndex;
+        std::vector<uint32_t> firstChild;
+        std::vector<uint64_t> hashes;
+        std::vector<float> sensors; // InputCount per agent
+        std::vector<float> actions; // OutputCount per agent
+
+        uint64_t cycleIndex = 0;
+        int stepIndex = 0;
+    };
+}
@@ -0,0 +1,45 @@
+#include "spatialgrid.h"
+
+#include <algorithm>
+
+namespace sim
+{
+    void SpatialGrid::configure(float worldSize, float cellSize)
+    {
+        size = cellSize;
+        inverseSize = 1.0f / cellSize;
+        halfWorld = 0.5f * worldSize;
+        cellsPerRow = static_cast<int>(std::ceil(worldSize / cellSize));
+        cellStart.assign(size_t(cellsPerRow) * cellsPerRow + 1, 0);
+    }
+
+    void SpatialGrid::build(const float *x, const float *y, size_t count)
+    {
+        agentCell.resize(count);
+        sortedIndex.resize(count);
+        std::fill(cellStart.begin(), cellStart.end(), 0);
+
+        // histogram, shifted by one so the prefix sum yields the start of every cell
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t cell = static_cast<uint32_t>(cellY(y[i]) * cellsPerRow + cellX(x[i]));
+            agentCell[i] = cell;
+            cellStart[cell + 1]++;
+        }
+        for (size_t c = 1; c < cellStart.size(); c++)
+        {
+            cellStart[c] += cellStart[c - 1];
+        }
+
+        // scatter; cellStart[c] runs up to the start of cell c + 1 and is restored afterwards
+        for (size_t i = 0; i < count; i++)
+        {
+            sortedIndex[cellStart[agentCell[i]]++] = static_cast<uint32_t>(i);
+        }
+        for (size_t c = cellStart.size() - 1; c > 0; c--)
+        {
+            cellStart[c] = cellStart[c - 1];
+        }
+        cellStart[0] = 0;
+    }
+}
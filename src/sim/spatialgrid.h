@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sim
+{
+    // Uniform grid over the square world for neighbour queries.
+    //
+    // build() sorts the agent indices by cell with a counting sort, so the agents of a cell are
+    // contiguous and the whole rebuild is two linear passes. With the cell size set to the agent
+    // diameter, all agents that can touch a given agent are in the surrounding 3x3 cells.
+    class SpatialGrid
+    {
+    public:
+        void configure(float worldSize, float cellSize);
+        void build(const float *x, const float *y, size_t count);
+
+        int cellsPerSide() const { return cellsPerRow; }
+        float cellSize() const { return size; }
+
+        int cellX(float x) const { return clampCell(static_cast<int>(std::floor((x + halfWorld) * inverseSize))); }
+        int cellY(float y) const { return clampCell(static_cast<int>(std::floor((y + halfWorld) * inverseSize))); }
+
+        // calls visit(index) for every agent in a cell within `reach` of (x,y) on both axes
+        template <typename Visitor>
+        void forEachNear(float x, float y, float reach, Visitor visit) const
+        {
+            int x0 = cellX(x - reach), x1 = cellX(x + reach);
+            int y0 = cellY(y - reach), y1 = cellY(y + reach);
+            for (int cy = y0; cy <= y1; cy++)
+            {
+                size_t row = size_t(cy) * cellsPerRow;
+                for (uint32_t i = cellStart[row + x0]; i < cellStart[row + x1 + 1]; i++)
+                {
+                    visit(sortedIndex[i]);
+                }
+            }
+        }
+
+    private:
+        int clampCell(int cell) const { return cell < 0 ? 0 : (cell >= cellsPerRow ? cellsPerRow - 1 : cell); }
+
+        float size = 1.0f;
+        float inverseSize = 1.0f;
+        float halfWorld = 0.0f;
+        int cellsPerRow = 0;
+
+        std::vector<uint32_t> cellStart;   // agents of cell c are sortedIndex[cellStart[c] .. cellStart[c + 1])
+        std::vector<uint32_t> sortedIndex;
+        std::vector<uint32_t> agentCell;
+    };
+}
@@ -0,0 +1,74 @@
+#include "targetfield.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sim
+{
+    // Rule 7: every target emits a gaussian field, densities of multiple targets add up
+    float TargetField::evaluate(const Config &config, float x, float y, float *gradientX, float *gradientY)
+    {
+        float sigma2 = config.targetFieldFalloff * config.targetFieldFalloff;
+        float density = 0.0f, gx = 0.0f, gy = 0.0f;
+        for (const Target &target : config.targets)
+        {
+            float dx = x - target.x, dy = y - target.y;
+            float value = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma2));
+            density += value;
+            gx -= value * dx / sigma2;
+            gy -= value * dy / sigma2;
+        }
+        if (gradientX)
+        {
+            *gradientX = gx;
+        }
+        if (gradientY)
+        {
+            *gradientY = gy;
+        }
+        return density;
+    }
+
+    void TargetField::bake(const Config &config)
+    {
+        nodesPerSide = std::max(config.targetFieldResolution, 2);
+        origin = -0.5f * config.worldSize;
+        float spacing = config.worldSize / (nodesPerSide - 1);
+        inverseSpacing = 1.0f / spacing;
+
+        nodes.resize(size_t(nodesPerSide) * nodesPerSide * 3);
+        float *node = nodes.data();
+        for (int j = 0; j < nodesPerSide; j++)
+        {
+            for (int i = 0; i < nodesPerSide; i++, node += 3)
+            {
+                node[0] = evaluate(config, origin + i * spacing, origin + j * spacing, &node[1], &node[2]);
+            }
+        }
+    }
+
+    float TargetField::sample(float x, float y, float *gradientX, float *gradientY) const
+    {
+        float fx = std::clamp((x - origin) * inverseSpacing, 0.0f, float(nodesPerSide - 1));
+        float fy = std::clamp((y - origin) * inverseSpacing, 0.0f, float(nodesPerSide - 1));
+        int i = std::min(static_cast<int>(fx), nodesPerSide - 2);
+        int j = std::min(static_cast<int>(fy), nodesPerSide - 2);
+        float tx = fx - i, ty = fy - j;
+
+        const float *n00 = &nodes[(size_t(j) * nodesPerSide + i) * 3];
+        const float *n10 = n00 + 3;
+        const float *n01 = n00 + size_t(nodesPerSide) * 3;
+        const float *n11 = n01 + 3;
+
+        float values[3];
+        for (int c = 0; c < 3; c++)
+        {
+            float bottom = n00[c] + (n10[c] - n00[c]) * tx;
+            float top = n01[c] + (n11[c] - n01[c]) * tx;
+            values[c] = bottom + (top - bottom) * ty;
+        }
+        *gradientX = values[1];
+        *gradientY = values[2];
+        return values[0];
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+#include "config.h"
+
+namespace sim
+{
+    // Target field (rule 7) and its gradient, baked into a grid over the world.
+    //
+    // Targets do not move within a run, so the gaussians are evaluated once per grid node instead
+    // of once per agent and step; sample() interpolates bilinearly between the nodes.
+    class TargetField
+    {
+    public:
+        // exact field density at (x,y), optionally with its gradient
+        static float evaluate(const Config &config, float x, float y, float *gradientX = nullptr, float *gradientY = nullptr);
+
+        void bake(const Config &config);
+        float sample(float x, float y, float *gradientX, float *gradientY) const;
+
+        // nodes per side; `data()` holds density, gradient x and gradient y per node, row by row from -y
+        int resolution() const { return nodesPerSide; }
+        const float *data() const { return nodes.data(); }
+
+    private:
+        int nodesPerSide = 0;
+        float origin = 0.0f;
+        float inverseSpacing = 1.0f;
+        std::vector<float> nodes;
+    };
+}
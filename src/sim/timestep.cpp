@@ -0,0 +1,33 @@
+#include "timestep.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sim
+{
+    // longest frame that is caught up on, avoids a spiral of death after stalls (e.g. window drag)
+    const double maxElapsedSeconds = 0.25;
+
+    FixedTimestep::FixedTimestep(double stepSeconds) : stepDuration(stepSeconds)
+    {
+    }
+
+    uint64_t FixedTimestep::advance(double elapsedSeconds)
+    {
+        if (isUnlimited())
+        {
+            accumulator = 0.0;
+            return unlimited;
+        }
+
+        accumulator += std::min(elapsedSeconds, maxElapsedSeconds) * speedMultiplier;
+        double steps = std::floor(accumulator / stepDuration);
+        accumulator -= steps * stepDuration;
+        return static_cast<uint64_t>(steps);
+    }
+
+    double FixedTimestep::secondsToNextStep() const
+    {
+        return isUnlimited() ? 0.0 : (stepDuration - accumulator) / speedMultiplier;
+    }
+}
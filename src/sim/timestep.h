@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+namespace sim
+{
+    // Fixed timestep with accumulator: decouples simulation steps from the frame rate.
+    //
+    // Real time passed to advance() is scaled by the speed multiplier and accumulated; every
+    // `stepSeconds` of accumulated time is one simulation step. The remainder only decides
+    // secondsToNextStep(); the renderer interpolates by the timestamps of the snapshots it gets.
+    // A speed of 0 means "as fast as possible": the caller runs steps until its frame budget
+    // is used up and draws the newest state.
+    class FixedTimestep
+    {
+    public:
+        static const uint64_t unlimited = UINT64_MAX;
+
+        explicit FixedTimestep(double stepSeconds);
+
+        void setSpeed(double multiplier) { speedMultiplier = multiplier; }
+        double speed() const { return speedMultiplier; }
+        bool isUnlimited() const { return speedMultiplier <= 0.0; }
+
+        // adds elapsed real time and returns the number of steps that are due
+        uint64_t advance(double elapsedSeconds);
+
+        // real time until the next step is due at the current speed
+        double secondsToNextStep() const;
+
+    private:
+        double stepDuration;
+        double speedMultiplier = 1.0;
+        double accumulator = 0.0;
+    };
+}
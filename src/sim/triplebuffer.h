@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace sim
+{
+    // Lock-free single producer, single consumer triple buffer.
+    //
+    // The writer fills back() and publish()es it, the reader calls fetch() and reads front().
+    // Both sides own one buffer exclusively; the third one is exchanged atomically together with
+    // a flag that marks it as newer than the reader's. Neither side ever waits for the other and
+    // the reader always gets the newest complete buffer; older unread ones are overwritten.
+    template <typename T>
+    class TripleBuffer
+    {
+    public:
+        // writer side
+        T &back() { return buffers[backIndex]; }
+
+        void publish()
+        {
+            backIndex = middle.exchange(backIndex | fresh, std::memory_order_acq_rel) & indexMask;
+        }
+
+        // reader side; returns true if front() now holds a newer buffer
+        bool fetch()
+        {
+            if (!(middle.load(std::memory_order_relaxed) & fresh))
+            {
+                return false;
+            }
+            frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & indexMask;
+            return true;
+        }
+
+        const T &front() const { return buffers[frontIndex]; }
+
+    private:
+        static const uint8_t indexMask = 0x3;
+        static const uint8_t fresh = 0x4;
+
+        T buffers[3];
+        std::atomic<uint8_t> middle{1};
+        uint8_t backIndex = 0;
+        uint8_t frontIndex = 2;
+    };
+}
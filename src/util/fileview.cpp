@@ -0,0 +1,174 @@
+#include "fileview.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace util
+{
+    // chunk size of the read() fallback when the file does not report its size
+    static const size_t readChunkSize = size_t(1) << 20;
+
+    FileView::~FileView()
+    {
+        close();
+    }
+
+    FileView::FileView(FileView &&other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    FileView &FileView::operator=(FileView &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            // the buffer keeps its address when it is moved, so `contents` stays valid
+            buffer = std::move(other.buffer);
+            contents = other.contents;
+            length = other.length;
+            mapping = other.mapping;
+            opened = other.opened;
+            other.contents = nullptr;
+            other.length = 0;
+            other.mapping = nullptr;
+            other.opened = false;
+        }
+        return *this;
+    }
+
+    bool FileView::open(const std::string &fileName, Access access)
+    {
+        close();
+        int fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat status;
+        if (fd < 0 || ::fstat(fd, &status) != 0)
+        {
+            int error = errno;
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+            errno = error;
+            return false;
+        }
+
+        size_t fileSize = static_cast<size_t>(status.st_size);
+        if (S_ISREG(status.st_mode) && fileSize > 0)
+        {
+            void *mapped = ::mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED)
+            {
+                ::madvise(mapped, fileSize, access == Random ? MADV_RANDOM : MADV_SEQUENTIAL);
+                ::close(fd);
+                mapping = mapped;
+                contents = static_cast<const char *>(mapped);
+                length = fileSize;
+                opened = true;
+                return true;
+            }
+        }
+
+        bool success = readAll(fd, fileSize);
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return success;
+    }
+
+    bool FileView::read(const std::string &fileName)
+    {
+        close();
+        int fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat status;
+        if (fd < 0 || ::fstat(fd, &status) != 0)
+        {
+            int error = errno;
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+            errno = error;
+            return false;
+        }
+        bool success = readAll(fd, static_cast<size_t>(status.st_size));
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return success;
+    }
+
+    bool FileView::readAll(int fd, size_t sizeHint)
+    {
+        auto readSome = [fd](char *target, size_t count)
+        {
+            ssize_t result;
+            do
+            {
+                result = ::read(fd, target, count);
+            } while (result < 0 && errno == EINTR);
+            return result;
+        };
+
+        // a single read() if the size is known, the buffer only grows for files that report none
+        size_t capacity = sizeHint > 0 ? sizeHint : readChunkSize;
+        std::unique_ptr<char[]> data(new char[capacity]);
+        size_t filled = 0;
+        while (true)
+        {
+            ssize_t count;
+            if (filled < capacity)
+            {
+                count = readSome(data.get() + filled, capacity - filled);
+            }
+            else
+            {
+                // full: only grow if there is more
+                char probe[4096];
+                count = readSome(probe, sizeof(probe));
+                if (count > 0)
+                {
+                    capacity += std::max(capacity, readChunkSize);
+                    std::unique_ptr<char[]> grown(new char[capacity]);
+                    std::memcpy(grown.get(), data.get(), filled);
+                    std::memcpy(grown.get() + filled, probe, size_t(count));
+                    data = std::move(grown);
+                }
+            }
+            if (count < 0)
+            {
+                return false;
+            }
+            if (count == 0)
+            {
+                break;
+            }
+            filled += static_cast<size_t>(count);
+        }
+        buffer = std::move(data);
+        contents = buffer.get();
+        length = filled;
+        opened = true;
+        return true;
+    }
+
+    void FileView::close()
+    {
+        if (mapping)
+        {
+            ::munmap(mapping, length);
+        }
+        mapping = nullptr;
+        contents = nullptr;
+        length = 0;
+        buffer.reset();
+        opened = false;
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace util
+{
+    // Read-only view of the contents of a whole file.
+    //
+    // Regular files are mapped into memory, so opening costs the same for a shader and for a
+    // checkpoint of several gigabytes and pages are only read when they are touched. Files that
+    // cannot be mapped (pipes, files in /proc that report no size) are read into a buffer owned
+    // by the view instead. Either way the contents stay valid until the view is closed.
+    class FileView
+    {
+    public:
+        // tells the kernel how the file is going to be read, see madvise()
+        enum Access
+        {
+            Sequential,
+            Random,
+        };
+
+        FileView() = default;
+        ~FileView();
+        FileView(FileView &&other) noexcept;
+        FileView &operator=(FileView &&other) noexcept;
+        FileView(const FileView &) = delete;
+        FileView &operator=(const FileView &) = delete;
+
+        // returns false with errno set if the file cannot be read
+        bool open(const std::string &fileName, Access access = Sequential);
+        // always reads the file into memory, the fallback of open(); use it for files that other
+        // processes may truncate while they are viewed, a mapping raises SIGBUS then
+        bool read(const std::string &fileName);
+        void close();
+
+        bool isOpen() const { return opened; }
+        bool isMapped() const { return mapping != nullptr; }
+
+        const char *data() const { return contents; }
+        const uint8_t *bytes() const { return reinterpret_cast<const uint8_t *>(contents); }
+        size_t size() const { return length; }
+        std::string_view text() const { return std::string_view(contents, length); }
+
+    private:
+        bool readAll(int fd, size_t sizeHint);
+
+        const char *contents = nullptr;
+        size_t length = 0;
+        void *mapping = nullptr;
+        std::unique_ptr<char[]> buffer; // read() fallback
+        bool opened = false;
+    };
+}
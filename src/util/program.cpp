@@ -0,0 +1,237 @@
+#include "program.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#include "shader.h"
+
+namespace shader
+{
+    Program::~Program()
+    {
+        destroy();
+    }
+
+    Program::Program(Program &&other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    Program &Program::operator=(Program &&other) noexcept
+    {
+        if (this != &other)
+        {
+            destroy();
+            program = other.program;
+            uniforms = std::move(other.uniforms);
+            blocks = std::move(other.blocks);
+            uploads = other.uploads;
+            skipped = other.skipped;
+            other.program = 0;
+            other.uniforms.clear();
+            other.blocks.clear();
+        }
+        return *this;
+    }
+
+    bool Program::load(const std::string &vertexShaderFileName, const std::string &fragmentShaderFileName)
+    {
+        GLuint linkedProgram = 0;
+        if (!loadShader(vertexShaderFileName.c_str(), fragmentShaderFileName.c_str(), nullptr /*geometryShader*/, &linkedProgram))
+        {
+            return false;
+        }
+        adopt(linkedProgram);
+        return true;
+    }
+
+    void Program::adopt(GLuint linkedProgram)
+    {
+        destroy();
+        program = linkedProgram;
+        introspect();
+    }
+
+    GLuint Program::release()
+    {
+        GLuint released = program;
+        program = 0;
+        destroy();
+        return released;
+    }
+
+    void Program::destroy()
+    {
+        if (program)
+        {
+            glDeleteProgram(program);
+        }
+        program = 0;
+        uniforms.clear();
+        blocks.clear();
+    }
+
+    void Program::introspect()
+    {
+        std::vector<char> name;
+        auto resourceName = [&](GLenum programInterface, GLuint index)
+        {
+            GLint maxLength = 0;
+            glGetProgramInterfaceiv(program, programInterface, GL_MAX_NAME_LENGTH, &maxLength);
+            name.assign(size_t(std::max(maxLength, 1)), 0);
+            glGetProgramResourceName(program, programInterface, index, GLsizei(name.size()), nullptr, name.data());
+            // arrays are reported as "name[0]" and set through their base name
+            char *subscript = std::strchr(name.data(), '[');
+            if (subscript)
+            {
+                *subscript = 0;
+            }
+            return hashName(name.data());
+        };
+
+        GLint count = 0;
+        glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+        uniforms.reserve(size_t(count));
+        for (GLint index = 0; index < count; index++)
+        {
+            const GLenum properties[] = {GL_LOCATION, GL_TYPE, GL_BLOCK_INDEX};
+            GLint values[3] = {};
+            glGetProgramResourceiv(program, GL_UNIFORM, GLuint(index), 3, properties, 3, nullptr, values);
+            // members of uniform blocks are backed by buffers, not set one by one
+            if (values[2] != -1 || values[0] < 0)
+            {
+                continue;
+            }
+            uniforms.push_back({resourceName(GL_UNIFORM, GLuint(index)), values[0], GLenum(values[1]), false, {}});
+        }
+
+        for (GLenum blockInterface : {GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK})
+        {
+            count = 0;
+            glGetProgramInterfaceiv(program, blockInterface, GL_ACTIVE_RESOURCES, &count);
+            for (GLint index = 0; index < count; index++)
+            {
+                const GLenum properties[] = {GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE};
+                GLint values[2] = {};
+                glGetProgramResourceiv(program, blockInterface, GLuint(index), 2, properties, 2, nullptr, values);
+                blocks.push_back({resourceName(blockInterface, GLuint(index)), blockInterface, values[0], values[1]});
+            }
+        }
+
+        std::sort(uniforms.begin(), uniforms.end(), [](const Uniform &a, const Uniform &b) { return a.hash < b.hash; });
+        std::sort(blocks.begin(), blocks.end(), [](const Block &a, const Block &b) { return a.hash < b.hash; });
+        auto sameUniform = [](const Uniform &a, const Uniform &b) { return a.hash == b.hash; };
+        auto sameBlock = [](const Block &a, const Block &b) { return a.hash == b.hash && a.blockInterface == b.blockInterface; };
+        if (std::adjacent_find(uniforms.begin(), uniforms.end(), sameUniform) != uniforms.end() ||
+            std::adjacent_find(blocks.begin(), blocks.end(), sameBlock) != blocks.end())
+        {
+            std::cerr << "[ERROR] Program " << program << " has names with the same hash, rename one of them" << std::endl;
+        }
+    }
+
+    static bool accepts(GLenum declared, GLenum type)
+    {
+        if (declared == type)
+        {
+            return true;
+        }
+        // booleans and samplers are set as integers
+        switch (declared)
+        {
+        case GL_BOOL:
+        case GL_SAMPLER_1D:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_BUFFER:
+        case GL_INT_SAMPLER_2D:
+        case GL_UNSIGNED_INT_SAMPLER_2D:
+            return type == GL_INT;
+        default:
+            return false;
+        }
+    }
+
+    Program::Uniform *Program::prepare(Name name, GLenum type, const void *value, size_t size)
+    {
+        Uniform *uniform = const_cast<Uniform *>(findUniform(name.hash));
+        if (!uniform || uniform->location < 0)
+        {
+            return nullptr;
+        }
+        if (!accepts(uniform->type, type))
+        {
+            std::cerr << "[ERROR] Uniform " << name.text << " of program " << program << " is set with the wrong type" << std::endl;
+            uniform->location = -1; // reported once, ignored from now on
+            return nullptr;
+        }
+        if (uniform->hasValue && std::memcmp(uniform->value, value, size) == 0)
+        {
+            skipped++;
+            return nullptr;
+        }
+        std::memcpy(uniform->value, value, size);
+        uniform->hasValue = true;
+        uploads++;
+        return uniform;
+    }
+
+    void Program::set(Name name, float value)
+    {
+        if (const Uniform *uniform = prepare(name, GL_FLOAT, &value, sizeof(value)))
+        {
+            glProgramUniform1f(program, uniform->location, value);
+        }
+    }
+
+    void Program::set(Name name, int value)
+    {
+        if (const Uniform *uniform = prepare(name, GL_INT, &value, sizeof(value)))
+        {
+            glProgramUniform1i(program, uniform->location, value);
+        }
+    }
+
+    void Program::set(Name name, const glm::vec2 &value)
+    {
+        const float components[2] = {value.x, value.y};
+        if (const Uniform *uniform = prepare(name, GL_FLOAT_VEC2, components, sizeof(components)))
+        {
+            glProgramUniform2f(program, uniform->location, value.x, value.y);
+        }
+    }
+
+    const Program::Uniform *Program::findUniform(uint32_t hash) const
+    {
+        auto found = std::lower_bound(uniforms.begin(), uniforms.end(), hash, [](const Uniform &uniform, uint32_t h) { return uniform.hash < h; });
+        return found != uniforms.end() && found->hash == hash ? &*found : nullptr;
+    }
+
+    const Program::Block *Program::findBlock(GLenum blockInterface, uint32_t hash) const
+    {
+        auto found = std::lower_bound(blocks.begin(), blocks.end(), hash, [](const Block &block, uint32_t h) { return block.hash < h; });
+        for (; found != blocks.end() && found->hash == hash; found++)
+        {
+            if (found->blockInterface == blockInterface)
+            {
+                return &*found;
+            }
+        }
+        return nullptr;
+    }
+
+    GLint Program::location(Name name) const
+    {
+        const Uniform *uniform = findUniform(name.hash);
+        return uniform ? uniform->location : -1;
+    }
+
+    GLint Program::blockBinding(GLenum blockInterface, Name name) const
+    {
+        const Block *block = findBlock(blockInterface, name.hash);
+        return block ? block->binding : -1;
+    }
+}
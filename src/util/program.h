@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm/glm.hpp>
+
+namespace shader
+{
+    // FNV-1a; usable in constant expressions, so names declared `constexpr` are hashed at compile time
+    constexpr uint32_t hashName(const char *name)
+    {
+        uint32_t hash = 2166136261u;
+        for (; *name; name++)
+        {
+            hash = (hash ^ uint8_t(*name)) * 16777619u;
+        }
+        return hash;
+    }
+
+    // Name of a uniform or block together with its hash
+    struct Name
+    {
+        constexpr Name(const char *text) : text(text), hash(hashName(text)) {}
+
+        const char *text;
+        uint32_t hash;
+    };
+
+    // A linked program with everything the render loop needs to feed it.
+    //
+    // Active uniforms and uniform/storage blocks are introspected once after linking and kept in
+    // flat tables sorted by name hash, so setting a uniform is a binary search instead of a
+    // glGetUniformLocation() call. The last value of every uniform is cached and uploads that
+    // would not change it are skipped. Values go through glProgramUniform*(), the program does
+    // not have to be in use.
+    class Program
+    {
+    public:
+        Program() = default;
+        ~Program();
+        // owns the GL program, copies would delete it twice
+        Program(Program &&other) noexcept;
+        Program &operator=(Program &&other) noexcept;
+        Program(const Program &) = delete;
+        Program &operator=(const Program &) = delete;
+
+        bool load(const std::string &vertexShaderFileName, const std::string &fragmentShaderFileName);
+        // takes ownership of a linked program
+        void adopt(GLuint linkedProgram);
+        // gives up ownership without deleting the program
+        GLuint release();
+        void destroy();
+
+        void use() const { glUseProgram(program); }
+        GLuint id() const { return program; }
+        bool isValid() const { return program != 0; }
+
+        // the value type must match the declaration; names that are not active are ignored
+        void set(Name name, float value);
+        void set(Name name, int value);
+        void set(Name name, const glm::vec2 &value);
+
+        // -1 if `name` is not an active uniform
+        GLint location(Name name) const;
+        // binding point of a uniform or shader storage block, -1 if the block is not active
+        GLint uniformBlockBinding(Name name) const { return blockBinding(GL_UNIFORM_BLOCK, name); }
+        GLint storageBlockBinding(Name name) const { return blockBinding(GL_SHADER_STORAGE_BLOCK, name); }
+
+        // true if the block holds exactly one T, for a trailing runtime-sized array one element;
+        // checks a C++ struct against the layout the shader declares
+        template <typename T>
+        bool blockMatches(GLenum blockInterface, Name name) const
+        {
+            const Block *block = findBlock(blockInterface, name.hash);
+            return block && block->dataSize == GLint(sizeof(T));
+        }
+
+        uint64_t uploadCount() const { return uploads; }
+        uint64_t skippedUploads() const { return skipped; }
+
+    private:
+        struct Uniform
+        {
+            uint32_t hash;
+            GLint location;
+            GLenum type;
+            bool hasValue;
+            uint32_t value[2]; // raw bits of the last upload
+        };
+
+        struct Block
+        {
+            uint32_t hash;
+            GLenum blockInterface;
+            GLint binding;
+            GLint dataSize;
+        };
+
+        void introspect();
+        // the uniform to upload to, nullptr if the value is unchanged or the name is unknown
+        Uniform *prepare(Name name, GLenum type, const void *value, size_t size);
+        const Uniform *findUniform(uint32_t hash) const;
+        const Block *findBlock(GLenum blockInterface, uint32_t hash) const;
+        GLint blockBinding(GLenum blockInterface, Name name) const;
+
+        GLuint program = 0;
+        std::vector<Uniform> uniforms; // sorted by hash
+        std::vector<Block> blocks;     // sorted by hash
+        uint64_t uploads = 0;
+        uint64_t skipped = 0;
+    };
+}
@@ -0,0 +1,243 @@
+#include "reloader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "shader.h"
+
+namespace shader
+{
+    // editors often save a file in several steps; a rebuild starts once the files were quiet this long
+    static const int debounceMilliseconds = 100;
+
+    static bool sameFile(const std::string &a, const std::string &b)
+    {
+        return std::filesystem::path(a).lexically_normal() == std::filesystem::path(b).lexically_normal();
+    }
+
+    ProgramReloader::~ProgramReloader()
+    {
+        stop();
+    }
+
+    void ProgramReloader::watch(Program &program, const std::string &vertexShaderFileName, const std::string &fragmentShaderFileName, Validator validate)
+    {
+        entries.push_back({&program, vertexShaderFileName, fragmentShaderFileName, validate});
+    }
+
+    bool ProgramReloader::start(GLFWwindow *window)
+    {
+        if (entries.empty())
+        {
+            return true;
+        }
+
+        inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        stopFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (inotifyFd < 0 || stopFd < 0)
+        {
+            std::cerr << "[ERROR] Could not watch shader files: " << std::strerror(errno) << std::endl;
+            stop();
+            return false;
+        }
+
+        // directories are watched instead of files, editors often replace a file when saving it
+        for (const Entry &entry : entries)
+        {
+            for (const std::string &fileName : {entry.vertexShaderFileName, entry.fragmentShaderFileName})
+            {
+                std::string directory = std::filesystem::path(fileName).parent_path().string();
+                if (directory.empty())
+                {
+                    directory = ".";
+                }
+                auto watched = [&directory](const std::pair<int, std::string> &d) { return d.second == directory; };
+                if (std::any_of(directories.begin(), directories.end(), watched))
+                {
+                    continue;
+                }
+                int descriptor = ::inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+                if (descriptor < 0)
+                {
+                    std::cerr << "[ERROR] Could not watch " << directory << ": " << std::strerror(errno) << std::endl;
+                    stop();
+                    return false;
+                }
+                directories.push_back({descriptor, directory});
+            }
+        }
+
+        // the context that compiles in the background; same version and profile as the viewer
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        context = glfwCreateWindow(1, 1, "shader reloader", nullptr, window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (!context)
+        {
+            std::cerr << "[ERROR] Could not create a shared context for shader reloading" << std::endl;
+            stop();
+            return false;
+        }
+
+        watcher = std::thread(&ProgramReloader::watchLoop, this);
+        std::cout << "[INFO] Watching " << directories.size() << " shader director" << (directories.size() == 1 ? "y" : "ies") << " for changes" << std::endl;
+        return true;
+    }
+
+    void ProgramReloader::stop()
+    {
+        if (watcher.joinable())
+        {
+            uint64_t one = 1;
+            if (::write(stopFd, &one, sizeof(one)) == sizeof(one))
+            {
+                watcher.join();
+            }
+            else
+            {
+                watcher.detach();
+            }
+        }
+        for (int fd : {inotifyFd, stopFd})
+        {
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+        }
+        inotifyFd = stopFd = -1;
+        directories.clear();
+
+        // programs that were never swapped in
+        for (const Rebuilt &program : rebuilt)
+        {
+            glDeleteProgram(program.program);
+        }
+        rebuilt.clear();
+
+        if (context)
+        {
+            glfwDestroyWindow(context);
+        }
+        context = nullptr;
+    }
+
+    void ProgramReloader::watchLoop()
+    {
+        glfwMakeContextCurrent(context);
+
+        pollfd descriptors[2] = {{inotifyFd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+        alignas(inotify_event) char buffer[4096];
+        std::vector<std::string> changedFiles;
+        while (true)
+        {
+            int ready = ::poll(descriptors, 2, changedFiles.empty() ? -1 : debounceMilliseconds);
+            if (ready < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (ready < 0 || descriptors[1].revents)
+            {
+                break;
+            }
+            if (ready == 0)
+            {
+                rebuild(changedFiles);
+                changedFiles.clear();
+                continue;
+            }
+
+            ssize_t length;
+            while ((length = ::read(inotifyFd, buffer, sizeof(buffer))) > 0)
+            {
+                for (char *next = buffer; next < buffer + length;)
+                {
+                    const inotify_event *event = reinterpret_cast<const inotify_event *>(next);
+                    next += sizeof(inotify_event) + event->len;
+                    for (const auto &directory : directories)
+                    {
+                        if (event->len > 0 && directory.first == event->wd)
+                        {
+                            changedFiles.push_back((std::filesystem::path(directory.second) / event->name).string());
+                        }
+                    }
+                }
+            }
+        }
+
+        glfwMakeContextCurrent(nullptr);
+    }
+
+    void ProgramReloader::rebuild(const std::vector<std::string> &changedFiles)
+    {
+        for (size_t index = 0; index < entries.size(); index++)
+        {
+            const Entry &entry = entries[index];
+            auto affects = [&entry](const std::string &fileName)
+            { return sameFile(fileName, entry.vertexShaderFileName) || sameFile(fileName, entry.fragmentShaderFileName); };
+            if (std::none_of(changedFiles.begin(), changedFiles.end(), affects))
+            {
+                continue;
+            }
+
+            GLuint program = 0;
+            if (!loadShader(entry.vertexShaderFileName.c_str(), entry.fragmentShaderFileName.c_str(), nullptr /*geometryShader*/, &program))
+            {
+                std::cerr << "[ERROR] Could not rebuild " << entry.vertexShaderFileName << ", keeping the previous program" << std::endl;
+                continue;
+            }
+            // the viewer's context only sees a program that is complete
+            glFinish();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            auto pending = std::find_if(rebuilt.begin(), rebuilt.end(), [index](const Rebuilt &r) { return r.entry == index; });
+            if (pending != rebuilt.end())
+            {
+                glDeleteProgram(pending->program);
+                pending->program = program;
+            }
+            else
+            {
+                rebuilt.push_back({index, program});
+            }
+        }
+    }
+
+    int ProgramReloader::apply()
+    {
+        std::vector<Rebuilt> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (rebuilt.empty())
+            {
+                return 0;
+            }
+            ready.swap(rebuilt);
+        }
+
+        int replaced = 0;
+        for (const Rebuilt &program : ready)
+        {
+            Entry &entry = entries[program.entry];
+            Program candidate;
+            candidate.adopt(program.program);
+            if (entry.validate && !entry.validate(candidate))
+            {
+                std::cerr << "[ERROR] Rebuilt " << entry.vertexShaderFileName << " was rejected, keeping the previous program" << std::endl;
+                candidate.destroy();
+                continue;
+            }
+            entry.program->adopt(candidate.release());
+            replaced++;
+            std::cout << "[INFO] Reloaded shader program " << entry.vertexShaderFileName << std::endl;
+        }
+        return replaced;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "program.h"
+
+namespace shader
+{
+    // Rebuilds programs while the viewer is running whenever one of their shader files changes.
+    //
+    // A background thread watches the directories of the registered files with inotify, reads
+    // and compiles changed programs on a hidden GLFW window whose context shares objects with
+    // the viewer, and hands finished programs to apply(), which swaps them in at a frame
+    // boundary. A program that fails to compile, link or validate is dropped and the previous
+    // one stays in use.
+    class ProgramReloader
+    {
+    public:
+        // returns false if a rebuilt program must not replace the current one
+        typedef std::function<bool(const Program &)> Validator;
+
+        ~ProgramReloader();
+
+        // register all programs before start()
+        void watch(Program &program, const std::string &vertexShaderFileName, const std::string &fragmentShaderFileName, Validator validate = nullptr);
+        // must be called from the thread that owns `window`
+        bool start(GLFWwindow *window);
+        void stop();
+
+        // swaps in rebuilt programs, returns the number of programs replaced
+        int apply();
+
+    private:
+        struct Entry
+        {
+            Program *program;
+            std::string vertexShaderFileName, fragmentShaderFileName;
+            Validator validate;
+        };
+
+        struct Rebuilt
+        {
+            size_t entry;
+            GLuint program;
+        };
+
+        void watchLoop();
+        void rebuild(const std::vector<std::string> &changedFiles);
+
+        std::vector<Entry> entries;
+        GLFWwindow *context = nullptr; // hidden, shares objects with the viewer
+        int inotifyFd = -1;
+        int stopFd = -1;
+        std::vector<std::pair<int, std::string>> directories; // watch descriptor, path
+        std::thread watcher;
+
+        std::mutex mutex;
+        std::vector<Rebuilt> rebuilt;
+    };
+}
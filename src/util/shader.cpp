@@ -1,7 +1,151 @@
 #include "shader.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+
 namespace shader
 {
+    static std::string binaryCacheDirectory;
+
+    // file layout: BinaryHeader followed by `length` bytes of the program binary
+    struct BinaryHeader
+    {
+        char magic[8];
+        uint64_t key;
+        uint32_t format;
+        uint32_t length;
+    };
+    static const char binaryMagic[8] = {'A', 'I', 'A', 'G', 'P', 'R', 'O', 'G'};
+
+    void setBinaryCacheDirectory(const std::string &directory)
+    {
+        binaryCacheDirectory.clear();
+        if (directory.empty())
+        {
+            return;
+        }
+
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (formats < 1)
+        {
+            std::cout << "[INFO] Shader binary cache disabled, the driver supports no program binary formats" << std::endl;
+        }
+        else if (error)
+        {
+            std::cerr << "[ERROR] Could not create shader binary cache " << directory << ": " << error.message() << std::endl;
+        }
+        else
+        {
+            binaryCacheDirectory = directory;
+        }
+    }
+
+    // FNV-1a over the driver identification and all sources
+    static uint64_t programKey(const std::string &vertexShaderSource, const std::string &fragmentShaderSource, const std::string &geometryShaderSource)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](const char *text)
+        {
+            for (const char *c = text ? text : ""; ; c++)
+            {
+                hash ^= uint8_t(*c);
+                hash *= 1099511628211ull;
+                if (*c == 0)
+                {
+                    break;
+                }
+            }
+        };
+        mix(reinterpret_cast<const char *>(glGetString(GL_VENDOR)));
+        mix(reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+        mix(reinterpret_cast<const char *>(glGetString(GL_VERSION)));
+        mix(vertexShaderSource.c_str());
+        mix(fragmentShaderSource.c_str());
+        mix(geometryShaderSource.c_str());
+        return hash;
+    }
+
+    static std::string binaryFileName(uint64_t key)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return (std::filesystem::path(binaryCacheDirectory) / name).string();
+    }
+
+    static bool loadProgramBinary(uint64_t key, GLuint *shaderProgram)
+    {
+        std::ifstream file(binaryFileName(key), std::ios::in | std::ios::binary);
+        if (!file.is_open())
+        {
+            return false;
+        }
+        BinaryHeader header;
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+            std::string(header.magic, sizeof(header.magic)) != std::string(binaryMagic, sizeof(binaryMagic)) || header.key != key)
+        {
+            return false;
+        }
+        std::vector<char> binary(header.length);
+        if (!file.read(binary.data(), binary.size()))
+        {
+            return false;
+        }
+
+        // a driver update can invalidate binaries even if the version string stays the same
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, header.format, binary.data(), GLsizei(binary.size()));
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            std::cout << "[INFO] Cached shader binary was rejected by the driver, compiling" << std::endl;
+            glDeleteProgram(program);
+            return false;
+        }
+        *shaderProgram = program;
+        return true;
+    }
+
+    static void storeProgramBinary(uint64_t key, GLuint shaderProgram)
+    {
+        GLint length = 0;
+        glGetProgramiv(shaderProgram, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+        {
+            return;
+        }
+        BinaryHeader header;
+        std::copy(binaryMagic, binaryMagic + sizeof(binaryMagic), header.magic);
+        header.key = key;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(shaderProgram, length, nullptr, &format, binary.data());
+        header.format = format;
+        header.length = uint32_t(length);
+
+        // written under a temporary name, so other instances never read a partial file
+        std::string fileName = binaryFileName(key);
+        std::string temporaryName = fileName + ".tmp";
+        {
+            std::ofstream file(temporaryName, std::ios::out | std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            file.write(binary.data(), binary.size());
+            if (!file)
+            {
+                std::cerr << "[ERROR] Could not write shader binary " << temporaryName << std::endl;
+                return;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporaryName, fileName, error);
+    }
+
     bool loadShader(const char *vertexShaderFileName, const char *fragmentShaderFileName, const char *geometryShaderFileName, GLuint *shaderProgram)
     {
         std::string vertexShaderSource = "";
@@ -18,10 +162,35 @@ namespace shader
 
         if (!vertexShaderSource.empty() && !fragmentShaderSource.empty())
         {
+            auto start = std::chrono::steady_clock::now();
+            auto milliseconds = [&start]()
+            { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+
+            uint64_t key = 0;
+            if (!binaryCacheDirectory.empty())
+            {
+                key = programKey(vertexShaderSource, fragmentShaderSource, geometryShaderSource);
+                if (loadProgramBinary(key, shaderProgram))
+                {
+                    std::cout << "[INFO] Shader program " << vertexShaderFileName << " loaded from binary cache in " << milliseconds() << "ms" << std::endl;
+                    return true;
+                }
+            }
+
             const char *vertexShaderData = vertexShaderSource.c_str();
             const char *fragmentShaderData = fragmentShaderSource.c_str();
             const char *geometryShaderData = geometryShaderFileName != nullptr ? geometryShaderSource.c_str() : nullptr;
-            return shader::compileShader(vertexShaderData, fragmentShaderData, geometryShaderData, shaderProgram);
+            if (!shader::compileShader(vertexShaderData, fragmentShaderData, geometryShaderData, shaderProgram))
+            {
+                return false;
+            }
+            std::cout << "[INFO] Shader program " << vertexShaderFileName << " compiled in " << milliseconds() << "ms" << std::endl;
+
+            if (!binaryCacheDirectory.empty())
+            {
+                storeProgramBinary(key, *shaderProgram);
+            }
+            return true;
         }
         else
         {
@@ -34,7 +203,18 @@ namespace shader
 
     bool compileShader(const char *vertexShaderData, const char *fragmentShaderData, const char *geometryShaderData, GLuint *shaderProgram)
     {
-        unsigned int vertexShaderObject, fragmentShaderObject, geometryShaderObject;
+        unsigned int vertexShaderObject = 0, fragmentShaderObject = 0, geometryShaderObject = 0;
+        // shaders are rebuilt while the viewer runs, failed attempts must not leak objects
+        auto deleteShaders = [&]()
+        {
+            for (unsigned int shaderObject : {vertexShaderObject, fragmentShaderObject, geometryShaderObject})
+            {
+                if (shaderObject)
+                {
+                    glDeleteShader(shaderObject);
+                }
+            }
+        };
         // Compile all shader and check for errors
         vertexShaderObject = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertexShaderObject, 1, &vertexShaderData, NULL);
@@ -42,6 +222,7 @@ namespace shader
 
         if(!shader::checkCompileErrors(vertexShaderObject, "VERTEX"))
         {
+            deleteShaders();
             return false;
         }
 
@@ -51,6 +232,7 @@ namespace shader
 
         if(!shader::checkCompileErrors(fragmentShaderObject, "FRAGMENT"))
         {
+            deleteShaders();
             return false;
         }
 
@@ -61,11 +243,14 @@ namespace shader
             glCompileShader(geometryShaderObject);
             if(!shader::checkCompileErrors(geometryShaderObject, "GEOMETRY"))
             {
+                deleteShaders();
                 return false;
             }
         }
 
         *shaderProgram = glCreateProgram();
+        // allows glGetProgramBinary() for the binary cache
+        glProgramParameteri(*shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glAttachShader(*shaderProgram, vertexShaderObject);
         glAttachShader(*shaderProgram, fragmentShaderObject);
         if (geometryShaderData != nullptr)
@@ -74,19 +259,16 @@ namespace shader
         }
         glLinkProgram(*shaderProgram);
         
+        // Clean up shader objects after compilation
+        deleteShaders();
+
         if(!shader::checkCompileErrors(*shaderProgram, "PROGRAM"))
         {
+            glDeleteProgram(*shaderProgram);
+            *shaderProgram = 0;
             return false;
         }
 
-        // Clean up shader objects after compilation
-        glDeleteShader(vertexShaderObject);
-        glDeleteShader(fragmentShaderObject);
-        if (geometryShaderData != nullptr)
-        {
-            glDeleteShader(geometryShaderObject);
-        }
-
         return true;
     }
 
@@ -129,7 +311,7 @@ namespace shader
         glUniform2f(glGetUniformLocation(shaderProgram, name), val.x, val.y);    
     }
 
-    void setInt(GLuint shaderProgram, const char *name, float val)
+    void setInt(GLuint shaderProgram, const char *name, int val)
     {
         glUniform1i(glGetUniformLocation(shaderProgram, name), val);
     }
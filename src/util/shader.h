@@ -8,11 +8,16 @@
 
 namespace shader
 {
+    // Linked programs are kept as driver binaries (glGetProgramBinary) in `directory`, keyed by
+    // their sources and the GL vendor, renderer and version; loadShader() restores them instead of
+    // compiling when nothing changed. An empty directory disables the cache.
+    void setBinaryCacheDirectory(const std::string &directory);
+
     bool loadShader(const char *vertexShaderFile, const char *fragmentShaderFile, const char *geometryShaderFile, GLuint *shaderProgram);
     bool compileShader(const char *vertexShaderData, const char *fragmentShaderData, const char *geometryShaderData, GLuint *shaderProgram);
     bool checkCompileErrors(unsigned int shaderObject, std::string shaderType);
 
     void setFloat(GLuint shaderProgram, const char *name, float value);
     void setVec2(GLuint shaderProgram, const char *name, const glm::vec2 &val);
-    void setInt(GLuint shaderProgram, const char *name, float val);
+    void setInt(GLuint shaderProgram, const char *name, int val);
 }
@@ -1,5 +1,7 @@
 #include "util.h"
 
+#include "fileview.h"
+
 namespace util
 {
     std::string currentTime(std::chrono::time_point<std::chrono::system_clock> now)
@@ -20,18 +22,14 @@ namespace util
 
     std::string readFile(std::string fileName)
     {
-        std::ifstream ifs(fileName, std::ios::in);
-
-        if (!ifs.is_open())
+        // read, not mapped: shaders are read while an editor may be truncating them, and touching a
+        // mapped page past the new end of the file raises SIGBUS
+        FileView view;
+        if (!view.read(fileName))
         {
             std::cerr << "[ERROR] Could not read file " << fileName << ". File does not exist." << std::endl;
             return "";
         }
-
-        std::string content((std::istreambuf_iterator<char>(ifs)),
-                            (std::istreambuf_iterator<char>()));
-
-        ifs.close();
-        return content;
+        return std::string(view.text());
     }
 }
\ No newline at end of file
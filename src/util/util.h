@@ -8,5 +8,6 @@
 namespace util
 {
     std::string currentTime(std::chrono::time_point<std::chrono::system_clock> now);
+    // a copy of the contents of `fileName`; use FileView to read without copying
     std::string readFile(std::string fileName);
 }
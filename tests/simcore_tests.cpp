@@ -0,0 +1,590 @@
+// Tests of the simulation core. Every test is a function that prints what went wrong and returns
+// false; the name of the test to run is the first argument, see add_test() in CMakeLists.txt.
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sim/recorder.h"
+#include "sim/simulation.h"
+#include "util/fileview.h"
+
+// Every heap allocation of the process goes through these replacements, so a test can count the
+// allocations made while it runs the simulation.
+static std::atomic<size_t> allocationCount{0};
+
+static void *countedAllocation(size_t size, size_t alignment)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void *pointer = nullptr;
+    if (alignment <= alignof(std::max_align_t))
+    {
+        pointer = std::malloc(size ? size : 1);
+    }
+    else if (posix_memalign(&pointer, alignment, size ? size : 1) != 0)
+    {
+        pointer = nullptr;
+    }
+    return pointer;
+}
+
+void *operator new(size_t size)
+{
+    void *pointer = countedAllocation(size, alignof(std::max_align_t));
+    if (!pointer)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    void *pointer = countedAllocation(size, size_t(alignment));
+    if (!pointer)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new[](size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return countedAllocation(size, alignof(std::max_align_t)); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return countedAllocation(size, alignof(std::max_align_t)); }
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept { return countedAllocation(size, size_t(alignment)); }
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept { return countedAllocation(size, size_t(alignment)); }
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { std::free(pointer); }
+void operator delete(void *pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept { std::free(pointer); }
+void operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept { std::free(pointer); }
+
+namespace
+{
+    using namespace sim;
+
+    // small enough to run in a moment, with several worker threads so the job system is covered
+    Config testConfig(unsigned threads)
+    {
+        Config config;
+        config.population = 2000;
+        config.stepsPerCycle = 20;
+        config.worldSize = 6.0f;
+        config.seed = 7;
+        config.threads = threads;
+        return config;
+    }
+
+    void runCycle(Simulation &simulation)
+    {
+        while (!simulation.cycleComplete())
+        {
+            simulation.step();
+        }
+        simulation.endCycle();
+    }
+
+    // Once the population has reached its size, neither step() nor endCycle() allocate: the per-step
+    // buffers keep their capacity and genomes and networks come from the generation arenas.
+    bool steadyStateAllocations()
+    {
+        const int warmUpCycles = 3, measuredCycles = 5;
+        Simulation simulation(testConfig(3));
+        if (!simulation.reset())
+        {
+            std::cerr << "[ERROR] Simulation initialization failed" << std::endl;
+            return false;
+        }
+        for (int cycle = 0; cycle < warmUpCycles; cycle++)
+        {
+            runCycle(simulation);
+        }
+
+        size_t before = allocationCount.load();
+        for (int cycle = 0; cycle < measuredCycles; cycle++)
+        {
+            runCycle(simulation);
+        }
+        size_t allocations = allocationCount.load() - before;
+        if (allocations != 0)
+        {
+            std::cerr << "[ERROR] " << allocations << " allocations in " << measuredCycles << " steady-state cycles" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    template <typename Column>
+    bool sameColumn(const char *name, const Column &a, const Column &b)
+    {
+        if (a.size() != b.size() || (!a.empty() && std::memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) != 0))
+        {
+            std::cerr << "[ERROR] Agent column " << name << " differs" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool sameAgents(const AgentStore &a, const AgentStore &b)
+    {
+        return sameColumn("x", a.x, b.x) && sameColumn("y", a.y, b.y) && sameColumn("velocity", a.velocity, b.velocity) &&
+               sameColumn("heading", a.heading, b.heading) && sameColumn("energy", a.energy, b.energy) &&
+               sameColumn("hidden", a.hidden, b.hidden) && sameColumn("genes", a.genes, b.genes) && sameColumn("color", a.color, b.color) &&
+               sameColumn("lineage", a.lineage, b.lineage) && sameColumn("birthCycle", a.birthCycle, b.birthCycle);
+    }
+
+    // everything but the timings and the allocation history, which differ between the runs
+    bool sameStats(const CycleStats &a, const CycleStats &b)
+    {
+        if (a.cycle != b.cycle || a.population != b.population || a.survivors != b.survivors || a.uniqueGenomes != b.uniqueGenomes ||
+            std::memcmp(&a.meanConnections, &b.meanConnections, sizeof(float)) != 0 ||
+            std::memcmp(&a.groupingRatio, &b.groupingRatio, sizeof(float)) != 0 ||
+            std::memcmp(&a.meanEnergy, &b.meanEnergy, sizeof(float)) != 0 || a.arenaBytes != b.arenaBytes)
+        {
+            std::cerr << "[ERROR] Stats of cycle " << a.cycle << " differ" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // A simulation saved in the middle of a cycle and resumed with another number of threads
+    // continues bit for bit like the one that was saved.
+    bool checkpointRoundTrip()
+    {
+        const std::string fileName = "simcore-tests-checkpoint.bin";
+        Simulation original(testConfig(3));
+        if (!original.reset())
+        {
+            std::cerr << "[ERROR] Simulation initialization failed" << std::endl;
+            return false;
+        }
+        runCycle(original);
+        runCycle(original);
+        for (int step = 0; step < original.config().stepsPerCycle / 2; step++)
+        {
+            original.step();
+        }
+        if (!original.saveCheckpoint(fileName))
+        {
+            return false;
+        }
+
+        Simulation resumed(testConfig(1));
+        bool loaded = resumed.loadCheckpoint(fileName);
+        std::remove(fileName.c_str());
+        if (!loaded)
+        {
+            return false;
+        }
+        if (resumed.cycle() != original.cycle() || resumed.stepInCycle() != original.stepInCycle() || !sameAgents(original.agents(), resumed.agents()))
+        {
+            std::cerr << "[ERROR] Resumed simulation differs from the saved one" << std::endl;
+            return false;
+        }
+
+        for (int cycle = 0; cycle < 3; cycle++)
+        {
+            while (!original.cycleComplete())
+            {
+                original.step();
+                resumed.step();
+            }
+            if (!sameAgents(original.agents(), resumed.agents()) || !sameStats(original.endCycle(), resumed.endCycle()) ||
+                !sameAgents(original.agents(), resumed.agents()))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // SIMD paths the CPU does not have are skipped, they would fall back to another path
+    bool supports(Isa isa)
+    {
+        if (supportedIsa(isa) != isa)
+        {
+            std::clog << "[INFO] " << isaName(isa) << " not supported, skipped" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    template <typename T>
+    bool sameArray(const char *name, const T *a, const T *b, size_t count)
+    {
+        if (count > 0 && std::memcmp(a, b, count * sizeof(T)) != 0)
+        {
+            std::cerr << "[ERROR] " << name << " differs" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // With Config::exactMovement the AVX2 integrator matches the scalar one bit for bit, which a
+    // checkpoint resumed on a machine with another instruction set relies on.
+    bool movementPaths()
+    {
+        const size_t count = 100000;
+        Config config = testConfig(1);
+        std::mt19937 random(11);
+        auto uniform = [&random](float low, float high) { return std::uniform_real_distribution<float>(low, high)(random); };
+
+        // some agents stand still, some are about to leave the world
+        AgentStore agents;
+        agents.reset(config.genomeLength, config.hiddenNeurons);
+        agents.add(count);
+        std::vector<float> actions(count * OutputCount);
+        float half = 0.5f * config.worldSize;
+        for (size_t i = 0; i < count; i++)
+        {
+            agents.x[i] = uniform(-half, half);
+            agents.y[i] = uniform(-half, half);
+            agents.velocity[i] = i % 5 == 0 ? 0.0f : uniform(0.0f, config.maxSpeed);
+            agents.heading[i] = uniform(-3.14159265f, 3.14159265f);
+            agents.energy[i] = uniform(0.0f, 1.0f);
+        }
+        for (float &action : actions)
+        {
+            action = uniform(-1.0f, 1.0f);
+        }
+
+        if (!supports(Isa::AVX2))
+        {
+            return true;
+        }
+        AgentStore scalar = agents, vector = agents;
+        std::vector<float> scalarX(count), scalarY(count), vectorX(count), vectorY(count);
+        movement::integrate(config, scalar, actions.data(), scalarX.data(), scalarY.data(), 0, count, Isa::Scalar);
+        movement::integrate(config, vector, actions.data(), vectorX.data(), vectorY.data(), 0, count, Isa::AVX2);
+        return sameArray("x", scalar.x.data(), vector.x.data(), count) && sameArray("y", scalar.y.data(), vector.y.data(), count) &&
+               sameArray("velocity", scalar.velocity.data(), vector.velocity.data(), count) &&
+               sameArray("heading", scalar.heading.data(), vector.heading.data(), count) &&
+               sameArray("energy", scalar.energy.data(), vector.energy.data(), count) &&
+               sameArray("targetX", scalarX.data(), vectorX.data(), count) && sameArray("targetY", scalarY.data(), vectorY.data(), count);
+    }
+
+    // The SIMD decoders compute the ID modulo with a multiplication, which must be exact for every
+    // number of hidden neurons a configuration allows.
+    bool decoderPaths()
+    {
+        // an odd number of genes, so the loops also run their tails
+        const size_t genomes = 1001;
+        const int length = 13;
+        std::mt19937 random(5);
+        std::vector<Gene> genes(genomes * length);
+        for (Gene &gene : genes)
+        {
+            gene = random();
+        }
+
+        std::vector<Isa> paths;
+        for (Isa isa : {Isa::SSE41, Isa::AVX2})
+        {
+            if (supports(isa))
+            {
+                paths.push_back(isa);
+            }
+        }
+
+        for (int hidden = 1; hidden <= 128; hidden++)
+        {
+            ConnectionTable expected;
+            expected.genomeLength = length;
+            genome::decodeBatch(genes.data(), genomes, hidden, expected, Isa::Scalar);
+            for (Isa isa : paths)
+            {
+                ConnectionTable table;
+                table.genomeLength = length;
+                genome::decodeBatch(genes.data(), genomes, hidden, table, isa);
+                if (!sameArray("source", expected.source.data(), table.source.data(), genes.size()) ||
+                    !sameArray("sink", expected.sink.data(), table.sink.data(), genes.size()) ||
+                    !sameArray("weight", expected.weight.data(), table.weight.data(), genes.size()))
+                {
+                    std::cerr << "[ERROR] " << isaName(isa) << " decoder differs with " << hidden << " hidden neurons" << std::endl;
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // A network evaluated in a batch gives the same values as evaluated on its own, on every
+    // instruction set; which networks share a batch must not change the results.
+    bool netbatchPaths()
+    {
+        // groups of identical genomes, so there are batches, with differing weights in every network
+        const int length = 24, hidden = 4, topologies = 10, copies = 37;
+        std::vector<Gene> genes(size_t(topologies) * copies * length);
+        CounterRng genomeRng(7, RandomStream::Genome, 0);
+        for (int t = 0; t < topologies; t++)
+        {
+            for (int c = 0; c < copies; c++)
+            {
+                genome::randomize(&genes[(size_t(t) * copies + c) * length], length, genomeRng, uint32_t(t));
+            }
+        }
+        ConnectionTable table;
+        table.genomeLength = length;
+        genome::decodeBatch(genes.data(), topologies * copies, hidden, table);
+        NetworkPrograms programs;
+        network::compileAll(table, hidden, programs);
+
+        std::mt19937 random(3);
+        std::uniform_real_distribution<float> uniform(-4.0f, 4.0f);
+        for (float &weight : programs.weight)
+        {
+            weight = uniform(random);
+        }
+        const int valueCount = network::valueCount(hidden);
+        std::vector<float> values(size_t(valueCount) * programs.networks());
+        for (float &value : values)
+        {
+            value = 0.25f * uniform(random);
+        }
+
+        for (Isa isa : {Isa::Scalar, Isa::AVX2, Isa::AVX512})
+        {
+            if (!supports(isa))
+            {
+                continue;
+            }
+            NetworkBatches batches;
+            network::buildBatches(programs, batches, isa);
+            if (batches.batches.empty())
+            {
+                std::cerr << "[ERROR] No batches built" << std::endl;
+                return false;
+            }
+            std::vector<float> lanes, single;
+            for (size_t b = 0; b < batches.batches.size(); b++)
+            {
+                const NetworkBatches::Batch &batch = batches.batches[b];
+                lanes.assign(size_t(valueCount) * batches.lanes, 0.0f);
+                for (uint32_t lane = 0; lane < batch.memberCount; lane++)
+                {
+                    uint32_t network = batches.members[batch.firstMember + lane];
+                    for (int v = 0; v < valueCount; v++)
+                    {
+                        lanes[size_t(v) * batches.lanes + lane] = values[size_t(network) * valueCount + v];
+                    }
+                }
+                network::evaluateBatch(programs, batches, b, lanes.data());
+
+                for (uint32_t lane = 0; lane < batch.memberCount; lane++)
+                {
+                    uint32_t network = batches.members[batch.firstMember + lane];
+                    single.assign(values.begin() + size_t(network) * valueCount, values.begin() + size_t(network + 1) * valueCount);
+                    network::evaluate(programs, network, single.data());
+                    for (int v = 0; v < valueCount; v++)
+                    {
+                        if (std::memcmp(&single[v], &lanes[size_t(v) * batches.lanes + lane], sizeof(float)) != 0)
+                        {
+                            std::cerr << "[ERROR] " << isaName(isa) << " batch " << b << " differs from network " << network << " at value " << v << std::endl;
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // A recording decodes to the recorded states within half a quantization step, sequentially and
+    // after seeking. Chunks are kept small, so they end both at the frame limit and at cycle ends.
+    bool trajectoryRoundTrip()
+    {
+        const std::string fileName = "simcore-tests-trajectory.bin";
+        const size_t framesPerChunk = 4;
+        const int cycles = 3;
+        Config config = testConfig(1);
+        config.population = 300;
+        config.stepsPerCycle = 10;
+        Simulation simulation(config);
+        if (!simulation.reset())
+        {
+            std::cerr << "[ERROR] Simulation initialization failed" << std::endl;
+            return false;
+        }
+
+        std::vector<TrajectoryFrame> recorded;
+        TrajectoryRecorder recorder;
+        if (!recorder.open(fileName, config, framesPerChunk))
+        {
+            return false;
+        }
+        auto record = [&]()
+        {
+            recorder.record(simulation);
+            TrajectoryFrame frame;
+            frame.cycle = simulation.cycle();
+            frame.step = simulation.stepInCycle();
+            frame.x.assign(simulation.agents().x.begin(), simulation.agents().x.end());
+            frame.y.assign(simulation.agents().y.begin(), simulation.agents().y.end());
+            frame.heading.assign(simulation.agents().heading.begin(), simulation.agents().heading.end());
+            recorded.push_back(std::move(frame));
+        };
+        record();
+        for (int cycle = 0; cycle < cycles; cycle++)
+        {
+            while (!simulation.cycleComplete())
+            {
+                simulation.step();
+                record();
+            }
+            simulation.endCycle();
+            record();
+        }
+        if (!recorder.close())
+        {
+            std::remove(fileName.c_str());
+            return false;
+        }
+
+        // the chunks start where a cycle starts or the previous chunk is full
+        std::vector<uint64_t> expectedStarts;
+        for (size_t frame = 0, inChunk = 0; frame < recorded.size(); frame++, inChunk++)
+        {
+            if (frame == 0 || inChunk == framesPerChunk || recorded[frame].cycle != recorded[frame - 1].cycle)
+            {
+                expectedStarts.push_back(frame);
+                inChunk = 0;
+            }
+        }
+        std::vector<uint64_t> chunkStarts;
+        util::FileView view;
+        if (view.read(fileName) && view.size() >= sizeof(trajectory::Header))
+        {
+            trajectory::Header header;
+            std::memcpy(&header, view.data(), sizeof(header));
+            for (uint64_t c = 0; c < header.chunkCount && header.indexOffset + (c + 1) * sizeof(trajectory::Index) <= view.size(); c++)
+            {
+                trajectory::Index entry;
+                std::memcpy(&entry, view.data() + header.indexOffset + c * sizeof(entry), sizeof(entry));
+                chunkStarts.push_back(entry.firstFrame);
+            }
+        }
+        view.close();
+
+        TrajectoryReader reader;
+        bool opened = reader.open(fileName);
+        std::remove(fileName.c_str());
+        if (!opened)
+        {
+            return false;
+        }
+        if (chunkStarts != expectedStarts)
+        {
+            std::cerr << "[ERROR] Chunks are not split at the frame limit and at cycle ends" << std::endl;
+            return false;
+        }
+        if (reader.frameCount() != recorded.size() || reader.agents() != config.population)
+        {
+            std::cerr << "[ERROR] Recording has " << reader.frameCount() << " frames of " << reader.agents() << " agents, expected "
+                      << recorded.size() << " of " << config.population << std::endl;
+            return false;
+        }
+
+        const float positionTolerance = 0.5f * config.worldSize / 65535.0f * 1.01f;
+        const float headingTolerance = 0.5f * 6.28318531f / 65536.0f * 1.01f;
+        auto matches = [&](const TrajectoryFrame &decoded, uint64_t frame)
+        {
+            const TrajectoryFrame &expected = recorded[frame];
+            if (decoded.cycle != expected.cycle || decoded.step != expected.step || decoded.x.size() != expected.x.size() ||
+                decoded.y.size() != expected.y.size() || decoded.heading.size() != expected.heading.size())
+            {
+                std::cerr << "[ERROR] Frame " << frame << " decodes as cycle " << decoded.cycle << " step " << decoded.step << std::endl;
+                return false;
+            }
+            for (size_t i = 0; i < expected.x.size(); i++)
+            {
+                float turn = std::remainder(decoded.heading[i] - expected.heading[i], 6.28318531f);
+                if (std::fabs(decoded.x[i] - expected.x[i]) > positionTolerance || std::fabs(decoded.y[i] - expected.y[i]) > positionTolerance ||
+                    std::fabs(turn) > headingTolerance)
+                {
+                    std::cerr << "[ERROR] Agent " << i << " of frame " << frame << " is off by more than half a quantization step" << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        TrajectoryFrame decoded;
+        for (uint64_t frame = 0; frame < recorded.size(); frame++)
+        {
+            if (!reader.next(decoded) || !matches(decoded, frame))
+            {
+                return false;
+            }
+        }
+        if (reader.next(decoded))
+        {
+            std::cerr << "[ERROR] Frame past the end of the recording" << std::endl;
+            return false;
+        }
+
+        // first frame, inside a chunk, at the frame limit, at a cycle end, last frame
+        const uint64_t cycleEnd = uint64_t(config.stepsPerCycle) + 1;
+        for (uint64_t frame : {uint64_t(0), uint64_t(2), uint64_t(framesPerChunk), cycleEnd, uint64_t(recorded.size() - 1)})
+        {
+            if (!reader.seek(frame) || !reader.next(decoded) || !matches(decoded, frame))
+            {
+                std::cerr << "[ERROR] Seeking to frame " << frame << " failed" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    struct Test
+    {
+        const char *name;
+        bool (*run)();
+    };
+
+    const Test tests[] = {
+        {"allocations", steadyStateAllocations},
+        {"checkpoint", checkpointRoundTrip},
+        {"movement", movementPaths},
+        {"decoder", decoderPaths},
+        {"netbatch", netbatchPaths},
+        {"trajectory", trajectoryRoundTrip},
+    };
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0, run = 0;
+    for (const Test &test : tests)
+    {
+        if (argc > 1 && std::strcmp(argv[1], test.name) != 0)
+        {
+            continue;
+        }
+        run++;
+        bool passed = test.run();
+        std::clog << (passed ? "[INFO] Passed " : "[ERROR] Failed ") << test.name << std::endl;
+        failed += !passed;
+    }
+    if (run == 0)
+    {
+        std::cerr << "[ERROR] Unknown test " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}